@@ -5,171 +5,559 @@
  * from ESPHome. It handles TLS connection, PIN authentication, AES encryption,
  * and motor control commands.
  *
+ * The protocol is implemented once, in SomfyPoeMotorBase, over a platform
+ * policy (see somfy_poe_platform.h); SomfyPoeMotor is the instantiation for
+ * the current build.
+ *
  * Based on reverse-engineered Somfy PoE Motor API v1.2
  */
 
 #pragma once
 
 #include "esphome.h"
-#include <WiFiClientSecure.h>
-#include <WiFiUdp.h>
 #include <ArduinoJson.h>
-#include "mbedtls/aes.h"
-#include "mbedtls/md.h"
+#include "somfy_poe_platform.h"
+#include "somfy_poe_slab_pool.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace esphome {
 namespace somfy_poe {
 
-class SomfyPoeMotor : public Component {
+// Online estimate of how a motor moves: travel rate per direction (from
+// consecutive position reports while moving) and the delay between sending
+// a move and the first report showing motion. Until samples arrive, the
+// nominal defaults are used.
+class SomfyPoeTravelModel {
  public:
-  SomfyPoeMotor(const char* motor_ip, const char* pin_code)
-    : motor_ip_(motor_ip),
-      pin_code_(pin_code),
-      tcp_port_(55056),
-      udp_port_(55055),
-      message_id_(1),
-      is_authenticated_(false),
-      current_position_(-1.0f),
-      target_id_("") {
+  static constexpr float DEFAULT_RATE = 5.0f;           // %/s
+  static constexpr uint32_t DEFAULT_DELAY_MS = 300;
+  static constexpr float SMOOTHING = 0.25f;             // EWMA weight of a new sample
+  static constexpr uint32_t MIN_SAMPLE_INTERVAL_MS = 200;
+  // Motion later than this was not caused by the command (it was elided,
+  // rejected or already at its target), so it gives no delay sample
+  static constexpr uint32_t MAX_COMMAND_DELAY_MS = 5000;
+
+  void on_command(uint32_t now_ms) {
+    command_ms_ = now_ms;
+    awaiting_motion_ = true;
   }
 
-  void setup() override {
-    ESP_LOGI("somfy_poe", "Setting up Somfy PoE Motor component");
+  // direction: -1 = up (towards 0%), 0 = stopped, 1 = down (towards 100%)
+  void on_report(uint32_t now_ms, float position, int direction) {
+    if (awaiting_motion_ && now_ms - command_ms_ > MAX_COMMAND_DELAY_MS) awaiting_motion_ = false;
+    if (direction != 0 && awaiting_motion_) {
+      awaiting_motion_ = false;
+      float delay = now_ms - command_ms_;
+      delay_ms_ = has_delay_ ? delay_ms_ + SMOOTHING * (delay - delay_ms_) : delay;
+      has_delay_ = true;
+    }
 
-    // Initialize UDP
-    udp_.begin(udp_port_);
+    // Rate samples span reports of the same uninterrupted motion. Reports
+    // closer together than the minimum interval extend the span instead.
+    if (direction == 0 || direction != anchor_direction_) {
+      anchor_ms_ = now_ms;
+      anchor_position_ = position;
+      anchor_direction_ = direction;
+      return;
+    }
+    if (now_ms - anchor_ms_ < MIN_SAMPLE_INTERVAL_MS) return;
+
+    float distance = fabsf(position - anchor_position_);
+    if (distance > 0.0f) {
+      float rate = distance * 1000.0f / (now_ms - anchor_ms_);
+      float& estimate = direction < 0 ? rate_up_ : rate_down_;
+      bool& known = direction < 0 ? has_rate_up_ : has_rate_down_;
+      estimate = known ? estimate + SMOOTHING * (rate - estimate) : rate;
+      known = true;
+    }
+    anchor_ms_ = now_ms;
+    anchor_position_ = position;
+  }
 
-    // Attempt initial connection
-    connect_and_authenticate();
+  float get_rate_up() const {
+    return has_rate_up_ ? rate_up_ : DEFAULT_RATE;
   }
 
-  void loop() override {
-    // Check for UDP responses
-    check_udp_responses();
+  float get_rate_down() const {
+    return has_rate_down_ ? rate_down_ : DEFAULT_RATE;
+  }
 
-    // Reconnect if connection was lost
-    if (!is_authenticated_ && millis() - last_connect_attempt_ > 30000) {
-      connect_and_authenticate();
+  uint32_t get_command_delay_ms() const {
+    return has_delay_ ? (uint32_t) delay_ms_ : DEFAULT_DELAY_MS;
+  }
+
+  bool is_learned() const {
+    return has_delay_ && has_rate_up_ && has_rate_down_;
+  }
+
+  // Expected time from sending a move until the motor arrives
+  uint32_t predict_duration_ms(float from, float to) const {
+    if (from == to) return 0;
+    float rate = to < from ? get_rate_up() : get_rate_down();
+    return get_command_delay_ms() + (uint32_t) (fabsf(to - from) * 1000.0f / rate);
+  }
+
+ private:
+  float rate_up_ = 0.0f;
+  float rate_down_ = 0.0f;
+  float delay_ms_ = 0.0f;
+  bool has_rate_up_ = false;
+  bool has_rate_down_ = false;
+  bool has_delay_ = false;
+
+  uint32_t command_ms_ = 0;
+  bool awaiting_motion_ = false;
+  uint32_t anchor_ms_ = 0;         // Start of the rate sample being collected
+  float anchor_position_ = 0.0f;
+  int anchor_direction_ = 0;
+};
+
+// Smoothed round-trip time and variance from correlated request/reply
+// pairs (Jacobson/Karels, as used by TCP in RFC 6298), from which the
+// retransmission timeout is derived.
+class SomfyPoeRttEstimator {
+ public:
+  static constexpr uint32_t INITIAL_RTO_MS = 1000;
+  static constexpr uint32_t MIN_RTO_MS = 50;
+  static constexpr uint32_t MAX_RTO_MS = 4000;
+
+  void add_sample(uint32_t rtt_us) {
+    int32_t rtt = (int32_t) rtt_us;
+    if (samples_ == 0) {
+      srtt_us_ = rtt;
+      rttvar_us_ = rtt / 2;
+    } else {
+      int32_t error = rtt - srtt_us_;
+      rttvar_us_ += ((error < 0 ? -error : error) - rttvar_us_) / 4;  // beta = 1/4
+      srtt_us_ += error / 8;                                          // alpha = 1/8
     }
+    samples_++;
   }
 
-  // Motor control methods
-  bool move_up() {
-    return send_move_command("move.up", -1.0f);
+  // SRTT + 4 * RTTVAR, clamped to [MIN_RTO_MS, MAX_RTO_MS]
+  uint32_t get_rto_ms() const {
+    if (samples_ == 0) return INITIAL_RTO_MS;
+    uint32_t rto_ms = (srtt_us_ + 4 * rttvar_us_ + 999) / 1000;
+    if (rto_ms < MIN_RTO_MS) return MIN_RTO_MS;
+    if (rto_ms > MAX_RTO_MS) return MAX_RTO_MS;
+    return rto_ms;
   }
 
-  bool move_down() {
-    return send_move_command("move.down", -1.0f);
+  // NAN until the first sample
+  float get_srtt_ms() const {
+    return samples_ == 0 ? NAN : srtt_us_ / 1000.0f;
   }
 
-  bool stop() {
-    return send_move_command("move.stop", -1.0f);
+  float get_rttvar_ms() const {
+    return samples_ == 0 ? NAN : rttvar_us_ / 1000.0f;
   }
 
-  bool move_to_position(float position) {
-    // Position: 0 = open, 100 = closed
-    if (position < 0.0f) position = 0.0f;
-    if (position > 100.0f) position = 100.0f;
-    return send_move_command("move.to", position);
+  uint32_t get_sample_count() const {
+    return samples_;
   }
 
-  bool wink() {
-    // Makes the motor jog briefly for identification
-    return send_move_command("move.wink", -1.0f);
+ private:
+  int32_t srtt_us_ = 0;
+  int32_t rttvar_us_ = 0;
+  uint32_t samples_ = 0;
+};
+
+// Latency distribution in power-of-two buckets: bucket i counts samples of
+// [2^i, 2^(i+1)) us, the last bucket everything above
+class SomfyPoeLatencyHistogram {
+ public:
+  static const uint8_t BUCKETS = 22;  // Last one from ~2.1 s
+
+  void add(uint32_t us) {
+    uint8_t bucket = us == 0 ? 0 : 31 - __builtin_clz(us);
+    counts_[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+    count_++;
+    sum_us_ += us;
   }
 
-  float get_position() {
-    request_position_update();
-    return current_position_;
+  uint32_t get_count() const {
+    return count_;
   }
 
-  const char* get_status() {
-    return current_status_.c_str();
+  uint32_t get_bucket(uint8_t bucket) const {
+    return counts_[bucket];
   }
 
-  void reconnect() {
-    is_authenticated_ = false;
-    connect_and_authenticate();
+  // NAN until the first sample
+  float get_mean_ms() const {
+    return count_ == 0 ? NAN : sum_us_ / 1000.0f / count_;
+  }
+
+  // Interpolated within the bucket holding the percentile (0-100)
+  float get_percentile_ms(float percentile) const {
+    if (count_ == 0) return NAN;
+    float rank = percentile / 100.0f * count_;
+    uint32_t below = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+      if (counts_[i] == 0 || below + counts_[i] < rank) {
+        below += counts_[i];
+        continue;
+      }
+      float low_us = i == 0 ? 0.0f : (float) (1u << i);
+      float width_us = i == 0 ? 2.0f : low_us;
+      return (low_us + (rank - below) / counts_[i] * width_us) / 1000.0f;
+    }
+    return (1u << (BUCKETS - 1)) / 1000.0f;
+  }
+
+  void reset() {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    sum_us_ = 0;
   }
 
  private:
-  // Connection parameters
-  const char* motor_ip_;
-  const char* pin_code_;
-  uint16_t tcp_port_;
-  uint16_t udp_port_;
+  uint32_t counts_[BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint64_t sum_us_ = 0;
+};
 
-  // State
-  uint32_t message_id_;
-  bool is_authenticated_;
-  float current_position_;
-  String current_status_;
-  String target_id_;
-  uint8_t aes_key_[16];
-  unsigned long last_connect_attempt_;
+// Token bucket limiting how fast commands are sent to one motor. The
+// effective rate drops additively each time a request times out and
+// recovers additively with each reply, so a struggling motor is given room
+// without penalizing a healthy one.
+class SomfyPoeTokenBucket {
+ public:
+  static constexpr float RATE_DECREASE = 0.5f;   // tokens/s per timeout
+  static constexpr float RATE_RECOVERY = 0.1f;   // tokens/s per reply
+  static constexpr float MIN_RATE = 0.2f;
+
+  void configure(float rate, float burst) {
+    configured_rate_ = rate;
+    rate_ = rate;
+    burst_ = burst;
+    tokens_ = burst;
+  }
 
-  // Network clients
-  WiFiClientSecure tcp_client_;
-  WiFiUDP udp_;
+  bool try_consume(uint32_t now_ms) {
+    refill(now_ms);
+    if (tokens_ < 1.0f) return false;
+    tokens_ -= 1.0f;
+    return true;
+  }
 
-  bool connect_and_authenticate() {
-    ESP_LOGI("somfy_poe", "Connecting to motor at %s:%d", motor_ip_, tcp_port_);
-    last_connect_attempt_ = millis();
+  void on_timeout() {
+    rate_ = std::max(MIN_RATE, rate_ - RATE_DECREASE);
+  }
 
-    // Configure TLS - motors use self-signed certificates
-    tcp_client_.setInsecure();  // Don't verify motor certificate
+  void on_reply() {
+    rate_ = std::min(configured_rate_, rate_ + RATE_RECOVERY);
+  }
 
-    // Connect to motor
-    if (!tcp_client_.connect(motor_ip_, tcp_port_)) {
-      ESP_LOGE("somfy_poe", "TCP connection failed");
-      return false;
+  // Current (possibly reduced) refill rate in tokens/s
+  float get_rate() const {
+    return rate_;
+  }
+
+  float get_configured_rate() const {
+    return configured_rate_;
+  }
+
+ private:
+  void refill(uint32_t now_ms) {
+    tokens_ = std::min(burst_, tokens_ + (now_ms - last_refill_ms_) * rate_ / 1000.0f);
+    last_refill_ms_ = now_ms;
+  }
+
+  float configured_rate_ = 2.0f;
+  float rate_ = 2.0f;
+  float burst_ = 5.0f;
+  float tokens_ = 5.0f;
+  uint32_t last_refill_ms_ = 0;
+};
+
+// Position samples per motor kept by SomfyPoeHistory
+#ifndef SOMFY_POE_HISTORY_SAMPLES
+#define SOMFY_POE_HISTORY_SAMPLES 128
+#endif
+
+// Ring of (time, position) samples, delta-encoded into 32 bits each: 20
+// bits of time since the previous sample in 10 ms units and 12 signed bits
+// of position change in 0.1% units. The absolute time and position of the
+// oldest sample are kept separately and advanced as samples are evicted.
+// Gaps longer than ~2.9 h are clamped.
+class SomfyPoeHistory {
+ public:
+  void add(uint32_t now_ms, float position) {
+    int32_t tenths = (int32_t) lroundf(position * 10.0f);
+    if (count_ > 0 && tenths == last_tenths_) return;
+
+    if (count_ == 0) {
+      base_ms_ = now_ms;
+      base_tenths_ = tenths;
+    } else {
+      if (count_ == SOMFY_POE_HISTORY_SAMPLES) evict();
+      uint32_t dt = std::min<uint32_t>((now_ms - last_ms_) / 10, MAX_DT);
+      int32_t delta = tenths - last_tenths_;
+      samples_[(head_ + count_ - 1) % SOMFY_POE_HISTORY_SAMPLES] = dt | ((uint32_t) (delta & 0xFFF) << 20);
     }
+    if (count_ < SOMFY_POE_HISTORY_SAMPLES) count_++;
+    last_ms_ = now_ms;
+    last_tenths_ = tenths;
+  }
 
-    ESP_LOGI("somfy_poe", "TCP connected, authenticating...");
+  size_t size() const {
+    return count_;
+  }
 
-    // Step 1: Authenticate with PIN
-    if (!authenticate_with_pin()) {
-      tcp_client_.stop();
-      return false;
+  // "<oldest ms>,<oldest position in 0.1%>" followed by ";<dt in 10 ms>,<delta
+  // in 0.1%>" per later sample; times are millis() of this controller
+  std::string encode() const {
+    std::string out;
+    if (count_ == 0) return out;
+    out.reserve(24 + count_ * 8);
+
+    char field[24];
+    snprintf(field, sizeof(field), "%u,%d", (unsigned) base_ms_, (int) base_tenths_);
+    out += field;
+    for (size_t i = 0; i + 1 < count_; i++) {
+      uint32_t sample = samples_[(head_ + i) % SOMFY_POE_HISTORY_SAMPLES];
+      snprintf(field, sizeof(field), ";%u,%d", (unsigned) (sample & MAX_DT), (int) decode_delta(sample));
+      out += field;
+    }
+    return out;
+  }
+
+ private:
+  static constexpr uint32_t MAX_DT = (1u << 20) - 1;
+
+  // samples_[head_ + i] holds the step from sample i to sample i + 1
+  uint32_t samples_[SOMFY_POE_HISTORY_SAMPLES];
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint32_t base_ms_ = 0;
+  int32_t base_tenths_ = 0;
+  uint32_t last_ms_ = 0;
+  int32_t last_tenths_ = 0;
+
+  static int32_t decode_delta(uint32_t sample) {
+    int32_t delta = sample >> 20;
+    return delta >= 0x800 ? delta - 0x1000 : delta;
+  }
+
+  void evict() {
+    uint32_t sample = samples_[head_];
+    base_ms_ += (sample & MAX_DT) * 10;
+    base_tenths_ += decode_delta(sample);
+    head_ = (head_ + 1) % SOMFY_POE_HISTORY_SAMPLES;
+    count_--;
+  }
+};
+
+// Circuit breaker state. A motor that keeps failing is isolated (OPEN):
+// commands are rejected at once and only a cheap periodic probe is spent
+// on it until it answers again.
+enum class SomfyPoeHealth : uint8_t {
+  HEALTHY,
+  DEGRADED,  // Recent failures, retransmits reduced
+  OPEN,      // Unresponsive, probing only
+};
+
+inline const char* somfy_poe_health_to_string(SomfyPoeHealth health) {
+  switch (health) {
+    case SomfyPoeHealth::HEALTHY:
+      return "healthy";
+    case SomfyPoeHealth::DEGRADED:
+      return "degraded";
+    case SomfyPoeHealth::OPEN:
+      return "open";
+  }
+  return "unknown";
+}
+
+// Serializes a UDP request into `out`; returns its length, or 0 if it does
+// not fit. A group_id addresses a group instead of target_id. position is
+// only sent with move.to, and seq only when non-zero.
+inline size_t somfy_poe_build_request(char* out, size_t capacity, uint32_t id, const char* method,
+                                      const char* target_id, float position, uint32_t seq,
+                                      const char* group_id = nullptr) {
+  StaticJsonDocument<512> doc;
+  doc["id"] = id;
+  doc["method"] = method;
+
+  JsonObject params = doc.createNestedObject("params");
+  if (group_id != nullptr) {
+    params["groupID"] = group_id;
+  } else {
+    params["targetID"] = target_id;
+  }
+  if (seq != 0) {
+    params["seq"] = seq;
+  }
+
+  // Add position parameter if needed
+  if (strcmp(method, "move.to") == 0 && position >= 0.0f) {
+    params["position"] = position;
+  }
+
+  if (measureJson(doc) >= capacity) {
+    ESP_LOGW("somfy_poe", "%s request too large", method);
+    return 0;
+  }
+  return serializeJson(doc, out, capacity);
+}
+
+// UDP framing: a random 16-byte IV followed by the PKCS7-padded JSON
+// message encrypted with AES-128-CBC under the session key
+template <typename Platform> class SomfyPoePacketCodec {
+ public:
+  void set_key(const uint8_t* key) {
+    memcpy(key_, key, sizeof(key_));
+  }
+
+  void clear_key() {
+    memset(key_, 0, sizeof(key_));
+  }
+
+  const uint8_t* get_key() const {
+    return key_;
+  }
+
+  // IV + PKCS7-padded ciphertext
+  static size_t encrypted_size(size_t message_len) {
+    return 16 + ((message_len / 16) + 1) * 16;
+  }
+
+  // Writes IV + AES-128-CBC(message) to `out`. Returns the packet length,
+  // or 0 if it does not fit in `capacity`.
+  size_t encrypt(const char* message, size_t message_len, uint8_t* out, size_t capacity) const {
+    size_t packet_len = encrypted_size(message_len);
+    if (packet_len > capacity) {
+      return 0;
+    }
+
+    // Generate random IV (16 bytes)
+    Platform::random_bytes(out, 16);
+
+    // Pad message to multiple of 16 bytes (PKCS7 padding)
+    uint8_t* payload = out + 16;
+    size_t padded_len = packet_len - 16;
+    uint8_t padding = padded_len - message_len;
+    memcpy(payload, message, message_len);
+    memset(payload + message_len, padding, padding);
+
+    // Encrypt in place using AES-128-CBC
+    uint8_t iv_copy[16];
+    memcpy(iv_copy, out, 16);
+    Platform::aes128_cbc(true, key_, iv_copy, payload, padded_len);
+
+    return packet_len;
+  }
+
+  // Decrypts a packet in place and returns the message inside it, or
+  // nullptr if the size or padding is invalid
+  const char* decrypt(uint8_t* packet, size_t packet_len, size_t* message_len) const {
+    if (packet_len < 32 || packet_len % 16 != 0) {
+      return nullptr;
+    }
+
+    // Extract IV and encrypted data
+    uint8_t iv[16];
+    memcpy(iv, packet, 16);
+
+    size_t encrypted_len = packet_len - 16;
+    uint8_t* decrypted = packet + 16;
+
+    // Decrypt in place using AES-128-CBC
+    Platform::aes128_cbc(false, key_, iv, decrypted, encrypted_len);
+
+    // Remove PKCS7 padding
+    uint8_t padding = decrypted[encrypted_len - 1];
+    if (padding == 0 || padding > 16) {
+      return nullptr;
     }
+    *message_len = encrypted_len - padding;
+    return reinterpret_cast<const char*>(decrypted);
+  }
 
-    // Step 2: Get AES encryption key
-    if (!get_encryption_key()) {
-      tcp_client_.stop();
+ private:
+  uint8_t key_[16] = {};
+};
+
+// The TLS half of a session: security.auth with the PIN, then security.get
+// for the AES key. It touches only its own fields and the TLS client it is
+// given, so it can run on another thread while the motor leaves that
+// client alone (see SomfyPoeMotorBase::set_handshake_executor()).
+template <typename Platform> class SomfyPoeHandshake {
+ public:
+  SomfyPoeHandshake(typename Platform::Tls* tls, const char* host, uint16_t port, const char* pin_code,
+                    uint32_t first_id)
+      : tls_(tls), host_(host), port_(port), pin_code_(pin_code), next_id_(first_id) {}
+
+  // Message ids used by run()
+  static const uint32_t MESSAGE_IDS = 2;
+
+  bool run() {
+    // Connect to motor (self-signed certificates are accepted)
+    if (!tls_->connect(host_, port_)) {
+      ESP_LOGE("somfy_poe", "TCP connection failed");
       return false;
     }
 
-    is_authenticated_ = true;
-    ESP_LOGI("somfy_poe", "Successfully authenticated with motor");
+    ESP_LOGI("somfy_poe", "TCP connected, authenticating...");
 
-    // Request initial position
-    request_position_update();
+    // Step 1: Authenticate with PIN, step 2: get AES encryption key
+    succeeded_ = authenticate_with_pin() && get_encryption_key();
+    if (!succeeded_) {
+      tls_->stop();
+    }
+    return succeeded_;
+  }
 
-    return true;
+  bool succeeded() const {
+    return succeeded_;
+  }
+
+  const std::string& get_target_id() const {
+    return target_id_;
   }
 
+  const uint8_t* get_key() const {
+    return key_;
+  }
+
+ private:
+  typename Platform::Tls* tls_;
+  const char* host_;
+  uint16_t port_;
+  const char* pin_code_;
+  uint32_t next_id_;
+  bool succeeded_ = false;
+  std::string target_id_;
+  uint8_t key_[16] = {};
+
   bool authenticate_with_pin() {
     // Create authentication request
     StaticJsonDocument<256> doc;
-    doc["id"] = message_id_++;
+    doc["id"] = next_id_++;
     doc["method"] = "security.auth";
     JsonObject params = doc.createNestedObject("params");
     params["code"] = pin_code_;
 
-    String request;
+    std::string request;
     serializeJson(doc, request);
 
     // Send request
-    tcp_client_.print(request);
+    tls_->write(request.data(), request.size());
 
     // Wait for response
-    if (!wait_for_tcp_response()) {
+    std::string response;
+    if (!read_tcp_response(response)) {
       ESP_LOGE("somfy_poe", "No authentication response");
       return false;
     }
 
     // Parse response
-    String response = tcp_client_.readString();
     StaticJsonDocument<512> response_doc;
     DeserializationError error = deserializeJson(response_doc, response);
 
@@ -183,8 +571,7 @@ class SomfyPoeMotor : public Component {
       return false;
     }
 
-    target_id_ = response_doc["targetID"].as<String>();
-    ESP_LOGI("somfy_poe", "Authenticated! Target ID: %s", target_id_.c_str());
+    target_id_ = response_doc["targetID"].as<std::string>();
 
     return true;
   }
@@ -192,23 +579,23 @@ class SomfyPoeMotor : public Component {
   bool get_encryption_key() {
     // Create key request
     StaticJsonDocument<256> doc;
-    doc["id"] = message_id_++;
+    doc["id"] = next_id_++;
     doc["method"] = "security.get";
 
-    String request;
+    std::string request;
     serializeJson(doc, request);
 
     // Send request
-    tcp_client_.print(request);
+    tls_->write(request.data(), request.size());
 
     // Wait for response
-    if (!wait_for_tcp_response()) {
+    std::string response;
+    if (!read_tcp_response(response)) {
       ESP_LOGE("somfy_poe", "No key exchange response");
       return false;
     }
 
     // Parse response
-    String response = tcp_client_.readString();
     StaticJsonDocument<512> response_doc;
     DeserializationError error = deserializeJson(response_doc, response);
 
@@ -225,185 +612,1361 @@ class SomfyPoeMotor : public Component {
     // Extract AES key from array
     JsonArray key_array = response_doc["key"].as<JsonArray>();
     for (int i = 0; i < 16; i++) {
-      aes_key_[i] = key_array[i].as<uint8_t>();
+      key_[i] = key_array[i].as<uint8_t>();
     }
 
     ESP_LOGI("somfy_poe", "AES key received");
     return true;
   }
 
-  bool wait_for_tcp_response(uint32_t timeout_ms = 5000) {
-    unsigned long start = millis();
-    while (!tcp_client_.available()) {
-      if (millis() - start > timeout_ms) {
+  // Reads one JSON reply from the TLS connection, up to the end of its
+  // top-level object. Fails if no data arrives for timeout_ms.
+  bool read_tcp_response(std::string& response, uint32_t timeout_ms = 5000) {
+    response.clear();
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    uint8_t buffer[256];
+
+    while (true) {
+      int n = tls_->read(buffer, sizeof(buffer), timeout_ms);
+      if (n <= 0) {
         return false;
       }
-      delay(10);
+
+      for (int i = 0; i < n; i++) {
+        char c = buffer[i];
+        response += c;
+        if (escaped) {
+          escaped = false;
+        } else if (in_string) {
+          escaped = c == '\\';
+          in_string = c != '"';
+        } else if (c == '"') {
+          in_string = true;
+        } else if (c == '{') {
+          depth++;
+        } else if (c == '}' && --depth == 0) {
+          return true;
+        }
+      }
     }
-    return true;
   }
+};
 
-  bool send_move_command(const char* method, float position) {
-    if (!is_authenticated_) {
-      ESP_LOGW("somfy_poe", "Not authenticated, cannot send command");
-      return false;
+template <typename Platform> class SomfyPoeMotorBase;
+
+// Dotted-quad IPv4 address in host byte order; false if `text` is not one
+inline bool somfy_poe_parse_ipv4(const char* text, uint32_t* address) {
+  uint32_t value = 0;
+  for (int part = 0; part < 4; part++) {
+    if (*text < '0' || *text > '9') return false;
+    uint32_t octet = 0;
+    while (*text >= '0' && *text <= '9') {
+      octet = octet * 10 + (*text++ - '0');
+      if (octet > 255) return false;
     }
+    value = (value << 8) | octet;
+    if (part < 3 && *text++ != '.') return false;
+  }
+  if (*text != '\0') return false;
+  *address = value;
+  return true;
+}
+
+// The controller's UDP port (55055), which motors reply and push to. Every
+// motor on a controller must share one socket: with a socket each, Linux
+// spreads incoming datagrams across them (SO_REUSEPORT) and lwIP hands all
+// of them to the first, so motors would read each other's replies. Each
+// datagram is routed to the motor at its source address instead. The hub
+// owns one for its motors; a motor outside a hub opens its own.
+template <typename Platform> class SomfyPoeUdpSocket {
+ public:
+  using Motor = SomfyPoeMotorBase<Platform>;
 
-    // Create command
-    StaticJsonDocument<512> doc;
-    doc["id"] = message_id_++;
-    doc["method"] = method;
-
-    JsonObject params = doc.createNestedObject("params");
-    params["targetID"] = target_id_;
-    params["seq"] = 1;
-
-    // Add position parameter if needed
-    if (strcmp(method, "move.to") == 0 && position >= 0.0f) {
-      params["position"] = position;
-    }
+  // At most this many datagrams per poll(), so a flood cannot stall the loop
+  static const int MAX_DATAGRAMS_PER_POLL = 256;
 
-    String command;
-    serializeJson(doc, command);
+  // Opens the socket on the first call; later calls report whether it is open
+  bool begin(uint16_t port) {
+    if (!open_) open_ = udp_.begin(port);
+    return open_;
+  }
 
-    // Encrypt and send via UDP
-    return send_encrypted_udp(command);
+  // Only once per socket, as enabling restarts the send numbering
+  bool enable_timestamps() {
+    if (!timestamps_) timestamps_ = udp_.enable_timestamps();
+    return timestamps_;
   }
 
-  bool request_position_update() {
-    if (!is_authenticated_) {
+  bool add_route(const char* host, Motor* motor) {
+    uint32_t address;
+    if (!somfy_poe_parse_ipv4(host, &address)) {
+      ESP_LOGW("somfy_poe", "Cannot route replies from '%s'", host);
       return false;
     }
-
-    // Create position query
-    StaticJsonDocument<256> doc;
-    doc["id"] = message_id_++;
-    doc["method"] = "status.position";
-
-    JsonObject params = doc.createNestedObject("params");
-    params["targetID"] = target_id_;
-
-    String query;
-    serializeJson(doc, query);
-
-    return send_encrypted_udp(query);
+    if (routes_.count(address) != 0 && routes_[address] != motor) {
+      ESP_LOGW("somfy_poe", "Two motors at %s, replies go to the last one", host);
+    }
+    routes_[address] = motor;
+    return true;
   }
 
-  bool send_encrypted_udp(const String& message) {
-    // Generate random IV (16 bytes)
-    uint8_t iv[16];
-    for (int i = 0; i < 16; i++) {
-      iv[i] = random(256);
-    }
+  void remove_route(const char* host, Motor* motor) {
+    uint32_t address;
+    if (!somfy_poe_parse_ipv4(host, &address)) return;
+    auto route = routes_.find(address);
+    if (route != routes_.end() && route->second == motor) routes_.erase(route);
+  }
 
-    // Pad message to multiple of 16 bytes (PKCS7 padding)
-    size_t message_len = message.length();
-    size_t padded_len = ((message_len / 16) + 1) * 16;
-    uint8_t padding = padded_len - message_len;
+  size_t get_route_count() const {
+    return routes_.size();
+  }
 
-    uint8_t* padded_message = new uint8_t[padded_len];
-    memcpy(padded_message, message.c_str(), message_len);
-    for (size_t i = message_len; i < padded_len; i++) {
-      padded_message[i] = padding;
+  // Reads the waiting datagrams and hands each to the motor that sent it
+  void poll() {
+    SomfyPoeSlabPool& pool = SomfyPoeSlabPool::instance();
+    for (int i = 0; i < MAX_DATAGRAMS_PER_POLL; i++) {
+      int size = udp_.next_datagram();
+      if (size <= 0) return;
+      uint32_t sender = udp_.sender();
+      uint8_t* buffer = pool.allocate(size);
+      udp_.read(buffer, size);
+
+      auto route = routes_.find(sender);
+      if (route != routes_.end()) {
+        route->second->receive_datagram(buffer, size);
+      } else {
+        unrouted_++;
+      }
+      pool.release(buffer);
     }
+  }
 
-    // Encrypt using AES-128-CBC
-    uint8_t* encrypted = new uint8_t[padded_len];
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-    mbedtls_aes_setkey_enc(&aes, aes_key_, 128);
+  // Datagrams from addresses without a motor
+  uint32_t get_unrouted_count() const {
+    return unrouted_;
+  }
 
-    uint8_t iv_copy[16];
-    memcpy(iv_copy, iv, 16);
-    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, padded_len,
-                          iv_copy, padded_message, encrypted);
-    mbedtls_aes_free(&aes);
+  bool send_to(const char* host, uint16_t port, const uint8_t* data, size_t len) {
+    return open_ && udp_.send_to(host, port, data, len);
+  }
 
-    // Send IV + encrypted data via UDP
-    udp_.beginPacket(motor_ip_, udp_port_);
-    udp_.write(iv, 16);
-    udp_.write(encrypted, padded_len);
-    bool success = udp_.endPacket();
+  uint32_t last_send_id() const {
+    return udp_.last_send_id();
+  }
 
-    // Cleanup
-    delete[] padded_message;
-    delete[] encrypted;
+  bool send_times(uint32_t id, uint64_t* software_ns, uint64_t* hardware_ns) {
+    return udp_.send_times(id, software_ns, hardware_ns);
+  }
 
-    return success;
+  // For the datagram being handed to a motor
+  bool receive_times(uint64_t* software_ns, uint64_t* hardware_ns) {
+    return udp_.receive_times(software_ns, hardware_ns);
   }
 
-  void check_udp_responses() {
-    int packet_size = udp_.parsePacket();
-    if (packet_size <= 0) {
-      return;
-    }
+  // The platform socket, e.g. for its descriptor on Linux
+  typename Platform::Udp& get_udp() {
+    return udp_;
+  }
 
-    // Read encrypted response
-    uint8_t* buffer = new uint8_t[packet_size];
-    udp_.read(buffer, packet_size);
+ private:
+  typename Platform::Udp udp_;
+  bool open_ = false;
+  bool timestamps_ = false;
+  std::unordered_map<uint32_t, Motor*> routes_;
+  uint32_t unrouted_ = 0;
+};
 
-    if (packet_size < 16) {
-      ESP_LOGW("somfy_poe", "UDP packet too small");
-      delete[] buffer;
-      return;
-    }
+template <typename Platform> class SomfyPoeMotorBase : public Component {
+ public:
+  SomfyPoeMotorBase(const char* motor_ip, const char* pin_code)
+    : motor_ip_(motor_ip),
+      pin_code_(pin_code),
+      tcp_port_(55056),
+      udp_port_(55055),
+      message_id_(1),
+      is_authenticated_(false),
+      current_position_(-1.0f),
+      position_settled_(false),
+      position_tolerance_(0.5f),
+      elided_commands_(0),
+      last_move_sent_(0),
+      move_seq_(0),
+      retransmits_(0),
+      timeouts_(0),
+      deferred_method_(nullptr),
+      deferred_position_(-1.0f),
+      coalesced_commands_(0),
+      health_(SomfyPoeHealth::HEALTHY),
+      consecutive_failures_(0),
+      probe_interval_ms_(PROBE_MIN_INTERVAL_MS),
+      next_probe_ms_(0),
+      groups_known_(false),
+      lazy_session_(false),
+      last_used_ms_(0),
+      position_stale_(false),
+      snapshot_dirty_(false),
+      last_snapshot_ms_(0),
+      target_id_("") {
+    current_status_[0] = '\0';
+  }
 
-    // Extract IV and encrypted data
-    uint8_t iv[16];
-    memcpy(iv, buffer, 16);
+  void setup() override {
+    ESP_LOGI("somfy_poe", "Setting up Somfy PoE Motor component");
 
-    size_t encrypted_len = packet_size - 16;
-    uint8_t* encrypted = buffer + 16;
+    // Initialize UDP
+    set_up_ = true;
+    open_udp();
+
+    restore_snapshot();
+
+    // A restored session is confirmed by the motor's first replies;
+    // otherwise connect, unless it is deferred to the first command
+    if (is_authenticated_) {
+      request_position_update();
+      request_group_memberships();
+      request_lock_state();
+    } else if (!lazy_session_) {
+      connect_and_authenticate();
+    }
+  }
 
-    // Decrypt using AES-128-CBC
-    uint8_t* decrypted = new uint8_t[encrypted_len];
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-    mbedtls_aes_setkey_dec(&aes, aes_key_, 128);
-    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, encrypted_len,
-                          iv, encrypted, decrypted);
-    mbedtls_aes_free(&aes);
+  void loop() override {
+    // Check for UDP responses (a shared socket is polled by its owner)
+    if (own_udp_ != nullptr) {
+      own_udp_->poll();
+    }
 
-    // Remove PKCS7 padding
-    uint8_t padding = decrypted[encrypted_len - 1];
-    size_t message_len = encrypted_len - padding;
+    // Resend requests whose reply is overdue
+    check_retransmits();
 
-    // Convert to string
-    String message = "";
-    for (size_t i = 0; i < message_len; i++) {
-      message += (char)decrypted[i];
+    // Send a move held back by the rate limiter once a token is available
+    if (deferred_method_ != nullptr && is_authenticated_ && rate_limiter_.try_consume(Platform::millis())) {
+      const char* method = deferred_method_;
+      deferred_method_ = nullptr;
+      send_move_command(method, deferred_position_);
     }
 
-    // Parse JSON response
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, message);
+    save_snapshot();
 
-    if (!error) {
-      process_response(doc);
-    } else {
-      ESP_LOGW("somfy_poe", "Failed to parse UDP response: %s", error.c_str());
+    // An isolated motor only gets a cheap probe on its own schedule
+    if (health_ == SomfyPoeHealth::OPEN) {
+      if ((int32_t) (Platform::millis() - next_probe_ms_) >= 0) {
+        probe();
+      }
+    } else if (!is_authenticated_ && !lazy_session_ && Platform::millis() - last_connect_attempt_ > 30000) {
+      // Reconnect if connection was lost (lazy sessions reconnect on demand)
+      connect_and_authenticate();
     }
 
-    // Cleanup
-    delete[] buffer;
-    delete[] decrypted;
+    report_state_change();
   }
 
-  void process_response(JsonDocument& doc) {
-    const char* method = doc["method"];
+  // Motor control methods
+  //
+  // Moves whose target matches the last known stopped position are elided
+  // (no datagram is sent) and reported as successful. Pass force = true to
+  // send the command regardless, e.g. to re-seat a blind after manual use.
+  //
+  // Moves beyond the motor's rate limit are not dropped: the latest one is
+  // held and sent as soon as the limit allows, replacing any move held
+  // before it. move.stop is never held back.
+  bool move_up(bool force = false) {
+    if (!force && is_redundant_move(0.0f)) return true;
+    return submit_move("move.up", -1.0f);
+  }
 
-    // Check if this is a position update
-    if (doc.containsKey("position")) {
-      JsonObject pos = doc["position"];
-      current_position_ = pos["value"].as<float>();
-      current_status_ = pos["direction"].as<String>();
+  bool move_down(bool force = false) {
+    if (!force && is_redundant_move(100.0f)) return true;
+    return submit_move("move.down", -1.0f);
+  }
 
-      ESP_LOGD("somfy_poe", "Position: %.1f%%, Status: %s",
-               current_position_, current_status_.c_str());
+  bool stop() {
+    if (health_ == SomfyPoeHealth::OPEN || !ensure_session()) {
+      return false;
     }
+    last_used_ms_ = Platform::millis();
 
-    // Log result status
-    if (doc.containsKey("result")) {
+    // A stop overrides anything still waiting for the rate limiter
+    drop_deferred_move();
+    rate_limiter_.try_consume(Platform::millis());
+    return send_move_command("move.stop", -1.0f);
+  }
+
+  bool move_to_position(float position, bool force = false) {
+    // Position: 0 = open, 100 = closed
+    if (position < 0.0f) position = 0.0f;
+    if (position > 100.0f) position = 100.0f;
+    if (!force && is_redundant_move(position)) return true;
+    return submit_move("move.to", position);
+  }
+
+  bool wink() {
+    // Makes the motor jog briefly for identification
+    return submit_move("move.wink", -1.0f);
+  }
+
+  // Commands per second and burst size allowed to this motor (default 2/s,
+  // burst 5). The rate is lowered automatically while requests time out.
+  void set_rate_limit(float rate, float burst) {
+    rate_limiter_.configure(rate, burst);
+  }
+
+  const SomfyPoeTokenBucket& get_rate_limiter() const {
+    return rate_limiter_;
+  }
+
+  // Moves replaced by a newer move while waiting for the rate limiter
+  uint32_t get_coalesced_command_count() const {
+    return coalesced_commands_;
+  }
+
+  SomfyPoeHealth get_health() const {
+    return health_;
+  }
+
+  const char* get_health_name() const {
+    return somfy_poe_health_to_string(health_);
+  }
+
+  float get_position() {
+    request_position_update();
+    return current_position_;
+  }
+
+  // Last reported (or restored) position, without querying the motor.
+  // Negative until the first report.
+  float get_reported_position() const {
+    return current_position_;
+  }
+
+  const char* get_status() {
+    return current_status_;
+  }
+
+  void reconnect() {
+    is_authenticated_ = false;
+    position_settled_ = false;
+    clear_pending_requests();
+    connect_and_authenticate();
+  }
+
+  // With a lazy session the motor does not connect in setup(). The TLS
+  // session and AES key are established by the first command instead, and
+  // may be closed again (see close_session()) to bound memory use.
+  void set_lazy_session(bool lazy) {
+    lazy_session_ = lazy;
+  }
+
+  bool is_lazy_session() const {
+    return lazy_session_;
+  }
+
+  // Called before a lazy session is established, so the owner can make room
+  void set_session_admission_callback(std::function<void(SomfyPoeMotorBase*)>&& callback) {
+    session_admission_ = std::move(callback);
+  }
+
+  using HandshakeExecutor = std::function<void(SomfyPoeHandshake<Platform>*, std::function<void()>&&)>;
+
+  // Runs handshakes elsewhere (e.g. a worker pool) instead of blocking the
+  // loop. The executor runs the handshake, then calls the callback on the
+  // loop thread; until then the motor holds moves as if rate limited. It
+  // must finish every handshake before the motor is destroyed.
+  void set_handshake_executor(HandshakeExecutor&& executor) {
+    handshake_executor_ = std::move(executor);
+  }
+
+  bool is_handshaking() const {
+    return handshake_ != nullptr;
+  }
+
+  // Resumes a session from a cached target ID and key (e.g. the fleet
+  // database) instead of a handshake; call before setup(). If the motor no
+  // longer accepts the key, its requests go unanswered. The first to expire
+  // counts as one breaker failure, and the motor falls back to a full
+  // handshake.
+  void restore_session(const char* target_id, const uint8_t* key) {
+    target_id_ = target_id;
+    codec_.set_key(key);
+    is_authenticated_ = true;
+    session_restored_ = true;
+  }
+
+  // Session key for caching, or nullptr without a session
+  const uint8_t* get_session_key() const {
+    return is_authenticated_ ? codec_.get_key() : nullptr;
+  }
+
+  const std::string& get_target_id() const {
+    return target_id_;
+  }
+
+  // Seeds group memberships (e.g. cached ones) until group.get answers
+  void restore_groups(const std::vector<std::string>& groups) {
+    groups_ = groups;
+    groups_known_ = true;
+    groups_callback_.call(groups_);
+  }
+
+  // Establishes the session if it is lazy and not connected yet
+  bool ensure_session() {
+    if (is_authenticated_) {
+      return true;
+    }
+    if (!lazy_session_ || health_ == SomfyPoeHealth::OPEN) {
+      return false;
+    }
+
+    if (session_admission_) {
+      session_admission_(this);
+    }
+    return connect_and_authenticate();
+  }
+
+  // Closes the TLS connection and forgets the session key. A lazy session
+  // is re-established transparently by the next command.
+  void close_session() {
+    if (!is_authenticated_) {
+      return;
+    }
+
+    ESP_LOGD("somfy_poe", "Closing session with motor at %s", motor_ip_);
+    tcp_client_.stop();
+    is_authenticated_ = false;
+    session_restored_ = false;
+    position_settled_ = false;
+    clear_pending_requests();
+    codec_.clear_key();
+  }
+
+  // True while the position is the one restored from flash at boot,
+  // before the motor has reported
+  bool is_position_stale() const {
+    return position_stale_;
+  }
+
+  // Lock state reported by lock.get. A locked motor ignores moves except
+  // from priority sources. Restored from flash at boot like the position,
+  // and stale until the motor answers.
+  bool is_locked() const {
+    return locked_ == 1;
+  }
+
+  bool is_lock_known() const {
+    return locked_ >= 0;
+  }
+
+  bool is_lock_stale() const {
+    return lock_stale_;
+  }
+
+  // Every distinct reported position, see SomfyPoeHistory::encode()
+  const SomfyPoeHistory& get_history() const {
+    return history_;
+  }
+
+  // millis() of the last command, for least-recently-used eviction
+  unsigned long get_last_used() const {
+    return last_used_ms_;
+  }
+
+  // True if nothing is in flight, so closing the session loses nothing
+  bool is_idle() const {
+    if (deferred_method_ != nullptr || strcmp(current_status_, "up") == 0 ||
+        strcmp(current_status_, "down") == 0) {
+      return false;
+    }
+    for (const auto& pending : pending_) {
+      if (pending.active) return false;
+    }
+    return true;
+  }
+
+  // Maximum distance (in %) between the requested target and the known
+  // stopped position for a move to be considered redundant. 0 only elides
+  // exact matches; use force = true on a single call to bypass the check.
+  void set_position_tolerance(float tolerance) {
+    position_tolerance_ = tolerance < 0.0f ? 0.0f : tolerance;
+  }
+
+  // Number of move commands suppressed because the motor was already there
+  uint32_t get_elided_command_count() const {
+    return elided_commands_;
+  }
+
+  // Sends a move to every motor in `group_id`. Group commands carry a
+  // groupID instead of a targetID and are broadcast on the UDP port,
+  // encrypted with this motor's session key.
+  bool send_group_command(const char* group_id, const char* method, float position) {
+    return send_move_command(method, position, group_id);
+  }
+
+  // Timed moves: arm_move_to_position() builds and encrypts the move now so
+  // that fire_armed_move() is a single socket write, e.g. at an agreed
+  // instant across controllers. Arming again replaces the armed move.
+  bool arm_move_to_position(float position) {
+    if (health_ == SomfyPoeHealth::OPEN || !ensure_session()) {
+      return false;
+    }
+    disarm_move();
+
+    uint32_t id = message_id_++;
+    uint32_t seq = ++move_seq_;
+    char command[MAX_REQUEST_JSON];
+    size_t command_len = build_request(command, sizeof(command), id, "move.to", position, seq);
+    if (command_len == 0) {
+      return false;
+    }
+
+    armed_move_ = track_request(id, command, command_len, "move.to", seq);
+    armed_move_->armed = true;
+    last_used_ms_ = Platform::millis();
+    return true;
+  }
+
+  bool has_armed_move() const {
+    return armed_move_ != nullptr;
+  }
+
+  bool fire_armed_move() {
+    if (armed_move_ == nullptr || !is_authenticated_) {
+      return false;
+    }
+
+    PendingRequest* slot = armed_move_;
+    armed_move_ = nullptr;
+    expect_motion();
+
+    slot->armed = false;
+    slot->sent_us = Platform::micros();
+    slot->sent_ms = Platform::millis();
+    return send_pending(slot);
+  }
+
+  void disarm_move() {
+    if (armed_move_ != nullptr) release_request(armed_move_);
+  }
+
+  // Called when a move for this motor was sent on its behalf (e.g. as part
+  // of a group command), so the cached position is no longer final.
+  void expect_motion() {
+    position_settled_ = false;
+    last_move_sent_ = Platform::millis();
+    travel_model_.on_command(last_move_sent_);
+
+    // Resending an older move now (or firing an armed one) could undo the
+    // new one
+    cancel_pending_moves();
+    disarm_move();
+  }
+
+  // Sends and receives through `socket` (the hub's), shared with other
+  // motors, instead of opening a socket of its own in setup(). nullptr
+  // detaches the motor from any socket, e.g. before it is deleted.
+  void set_udp_socket(SomfyPoeUdpSocket<Platform>* socket) {
+    if (udp_ != nullptr) udp_->remove_route(motor_ip_, this);
+    own_udp_.reset();
+    udp_ = socket;
+    if (udp_ == nullptr) return;
+    udp_->add_route(motor_ip_, this);
+    if (set_up_) open_udp();
+  }
+
+  // Link quality diagnostics
+  const SomfyPoeRttEstimator& get_rtt_estimator() const {
+    return rtt_;
+  }
+
+  float get_srtt_ms() const {
+    return rtt_.get_srtt_ms();
+  }
+
+  // Kernel timestamps (SO_TIMESTAMPING) for the latency histograms below,
+  // where the platform has them (Linux). Call before setup().
+  void set_kernel_timestamps(bool enabled) {
+    kernel_timestamps_ = enabled;
+  }
+
+  bool has_kernel_timestamps() const {
+    return kernel_timestamps_;
+  }
+
+  // Round trips as seen by this code: from the send call to processing the
+  // reply (first transmissions only)
+  const SomfyPoeLatencyHistogram& get_rtt_histogram() const {
+    return rtt_histogram_;
+  }
+
+  // The same round trips between the kernel's transmit and receive times
+  // (the NIC's, if it stamps packets). Needs kernel timestamps.
+  const SomfyPoeLatencyHistogram& get_wire_rtt_histogram() const {
+    return wire_rtt_histogram_;
+  }
+
+  // From the send call to the kernel transmitting the request
+  const SomfyPoeLatencyHistogram& get_send_delay_histogram() const {
+    return send_delay_histogram_;
+  }
+
+  // From the kernel receiving any datagram, pushes included, to this code
+  // reading it
+  const SomfyPoeLatencyHistogram& get_receive_delay_histogram() const {
+    return receive_delay_histogram_;
+  }
+
+  uint32_t get_retransmit_count() const {
+    return retransmits_;
+  }
+
+  // Requests abandoned after MAX_RETRANSMITS without a reply
+  uint32_t get_timeout_count() const {
+    return timeouts_;
+  }
+
+  const SomfyPoeTravelModel& get_travel_model() const {
+    return travel_model_;
+  }
+
+  // Expected time for a move sent now to reach `target`, using the learned
+  // travel model. 0 if the position is not known yet.
+  uint32_t predict_move_duration_ms(float target) const {
+    if (current_position_ < 0.0f) return 0;
+    return travel_model_.predict_duration_ms(current_position_, target);
+  }
+
+  bool is_authenticated() const {
+    return is_authenticated_;
+  }
+
+  const char* get_motor_ip() const {
+    return motor_ip_;
+  }
+
+  // Group memberships reported by group.get after authentication
+  bool has_group_memberships() const {
+    return groups_known_;
+  }
+
+  const std::vector<std::string>& get_groups() const {
+    return groups_;
+  }
+
+  // Called with (position, moving) for every position report, whether a
+  // reply to status.position or an unsolicited push
+  void add_on_position_callback(std::function<void(float, bool)>&& callback) {
+    position_callback_.add(std::move(callback));
+  }
+
+  // Called when the motor's health or session changes, noticed once per
+  // loop pass. Position reports have their own callback.
+  void add_on_state_callback(std::function<void()>&& callback) {
+    state_callback_.add(std::move(callback));
+  }
+
+  // Called with the lock state whenever the motor reports it, and at boot
+  // with the one restored from flash
+  void add_on_lock_callback(std::function<void(bool)>&& callback) {
+    lock_callback_.add(std::move(callback));
+  }
+
+  // Called with the new memberships whenever a group.get reply arrives
+  void add_on_groups_callback(std::function<void(const std::vector<std::string>&)>&& callback) {
+    groups_callback_.add(std::move(callback));
+  }
+
+  // Called with (seq, ok) once a move's outcome is known: the motor's reply
+  // (ok = its "result"), or ok = false when it timed out, was dropped while
+  // held by the rate limiter, or the session closed. Group moves have no
+  // reply and are not reported.
+  void add_on_move_result_callback(std::function<void(uint32_t, bool)>&& callback) {
+    move_result_callback_.add(std::move(callback));
+  }
+
+  // Sequence number of the last move sent; a held move will get the next one
+  uint32_t get_move_seq() const {
+    return move_seq_;
+  }
+
+  bool has_deferred_move() const {
+    return deferred_method_ != nullptr;
+  }
+
+  // True while the reply to move `seq` is still expected
+  bool is_awaiting_move(uint32_t seq) const {
+    for (const auto& pending : pending_) {
+      if (pending.active && pending.seq == seq && seq != 0) return true;
+    }
+    return false;
+  }
+
+ private:
+  // Connection parameters
+  const char* motor_ip_;
+  const char* pin_code_;
+  uint16_t tcp_port_;
+  uint16_t udp_port_;
+
+  // State
+  uint32_t message_id_;
+  bool is_authenticated_;
+  float current_position_;
+  bool position_settled_;        // current_position_ is a fresh "stopped" report
+  float position_tolerance_;
+  uint32_t elided_commands_;
+  unsigned long last_move_sent_;
+  SomfyPoeTravelModel travel_model_;
+
+  // Unicast requests awaiting a reply, correlated by message id
+  struct PendingRequest {
+    bool active;
+    bool retransmit;       // Cleared when superseded by a newer move
+    bool armed;            // Encrypted ahead of time, not sent yet
+    uint32_t id;
+    const char* method;    // String literal
+    uint32_t seq;          // 0 for queries
+    uint32_t sent_us;
+    unsigned long sent_ms;
+    uint32_t send_id;      // Udp::last_send_id(), for kernel timestamps
+    uint8_t retries;
+    uint8_t* packet;       // Encrypted IV + ciphertext from the slab pool, resent as-is
+    size_t packet_len;
+  };
+  static const size_t MAX_PENDING_REQUESTS = 4;
+  static const uint8_t MAX_RETRANSMITS = 3;
+  PendingRequest pending_[MAX_PENDING_REQUESTS] = {};
+  PendingRequest* armed_move_ = nullptr;
+  SomfyPoeRttEstimator rtt_;
+  SomfyPoeLatencyHistogram rtt_histogram_;
+  SomfyPoeLatencyHistogram wire_rtt_histogram_;
+  SomfyPoeLatencyHistogram send_delay_histogram_;
+  SomfyPoeLatencyHistogram receive_delay_histogram_;
+  bool kernel_timestamps_ = false;
+  bool have_receive_times_ = false;  // For the datagram being processed
+  uint64_t receive_software_ns_ = 0;
+  uint64_t receive_hardware_ns_ = 0;
+  uint32_t move_seq_;
+  uint32_t retransmits_;
+  uint32_t timeouts_;
+
+  // Rate limiting; at most one move waits for a token, the latest wins
+  SomfyPoeTokenBucket rate_limiter_;
+  const char* deferred_method_;
+  float deferred_position_;
+  uint32_t coalesced_commands_;
+
+  // Handshake in flight, owned here; the executor only borrows it
+  std::unique_ptr<SomfyPoeHandshake<Platform>> handshake_;
+  HandshakeExecutor handshake_executor_;
+
+  // Session from restore_session(), until the motor's first reply
+  bool session_restored_ = false;
+
+  // Circuit breaker. Failures are requests that exhausted their retransmits
+  // and failed handshakes; any reply or successful handshake resets them.
+  static const uint8_t DEGRADED_AFTER_FAILURES = 1;
+  static const uint8_t OPEN_AFTER_FAILURES = 3;
+  static constexpr uint32_t PROBE_MIN_INTERVAL_MS = 10000;
+  static constexpr uint32_t PROBE_MAX_INTERVAL_MS = 300000;
+  static const uint32_t PROBE_TIMEOUT_MS = 300;
+  SomfyPoeHealth health_;
+  uint8_t consecutive_failures_;
+  uint32_t probe_interval_ms_;
+  unsigned long next_probe_ms_;
+  bool groups_known_;
+  bool lazy_session_;
+  unsigned long last_used_ms_;
+  std::function<void(SomfyPoeMotorBase*)> session_admission_;
+
+  // Last stopped position and lock state, kept in flash so they can be
+  // published at boot. Writes happen at most once per
+  // SNAPSHOT_MIN_INTERVAL_MS and only for position changes of at least
+  // SNAPSHOT_MIN_CHANGE or a lock change, to spare the flash. A persisted
+  // motor is always stopped, so there is no direction to keep.
+  struct StateSnapshot {
+    float position;  // -1 = unknown
+    int8_t locked;   // -1 = unknown
+  };
+  static const uint32_t SNAPSHOT_MIN_INTERVAL_MS = 60000;
+  static constexpr float SNAPSHOT_MIN_CHANGE = 0.5f;
+  ESPPreferenceObject snapshot_preference_;
+  StateSnapshot snapshot_{-1.0f, -1};
+  bool position_stale_;
+  int8_t locked_ = -1;
+  bool lock_stale_ = false;
+  SomfyPoeHistory history_;
+  bool snapshot_dirty_;
+  unsigned long last_snapshot_ms_;
+  std::vector<std::string> groups_;
+  CallbackManager<void(float, bool)> position_callback_;
+  CallbackManager<void(const std::vector<std::string>&)> groups_callback_;
+  CallbackManager<void(uint32_t, bool)> move_result_callback_;
+  CallbackManager<void()> state_callback_;
+  CallbackManager<void(bool)> lock_callback_;
+  SomfyPoeHealth reported_health_ = SomfyPoeHealth::HEALTHY;
+  bool reported_authenticated_ = false;
+  char current_status_[12];       // "stopped", "up" or "down"
+  std::string target_id_;
+  SomfyPoePacketCodec<Platform> codec_;
+  unsigned long last_connect_attempt_;
+
+  // Reports that arrive this soon after a move may predate the motor
+  // starting, so they cannot be trusted to describe the final position.
+  static const uint32_t MOVE_SETTLE_MS = 2000;
+
+  // Destination for groupID-addressed commands
+  static constexpr const char* GROUP_BROADCAST_ADDRESS = "255.255.255.255";
+
+  // Largest request JSON (a move addressed to a long groupID)
+  static const size_t MAX_REQUEST_JSON = 256;
+
+  // Network clients. udp_ is the hub's socket or own_udp_.
+  typename Platform::Tls tcp_client_;
+  SomfyPoeUdpSocket<Platform>* udp_ = nullptr;
+  std::unique_ptr<SomfyPoeUdpSocket<Platform>> own_udp_;
+  bool set_up_ = false;
+
+  friend class SomfyPoeUdpSocket<Platform>;
+
+  // Opens a socket of the motor's own unless it shares one
+  void open_udp() {
+    if (udp_ == nullptr) {
+      own_udp_.reset(new SomfyPoeUdpSocket<Platform>());
+      udp_ = own_udp_.get();
+      udp_->add_route(motor_ip_, this);
+    }
+    if (!udp_->begin(udp_port_)) {
+      ESP_LOGE("somfy_poe", "Cannot open UDP port %u", (unsigned) udp_port_);
+    }
+    if (kernel_timestamps_ && !udp_->enable_timestamps()) {
+      ESP_LOGW("somfy_poe", "Kernel timestamps not available for %s", motor_ip_);
+      kernel_timestamps_ = false;
+    }
+  }
+
+  // Starts a handshake, or runs it right away without an executor. Returns
+  // true only once the session is established.
+  bool connect_and_authenticate() {
+    if (handshake_ != nullptr) {
+      return false;  // Already in flight
+    }
+
+    ESP_LOGI("somfy_poe", "Connecting to motor at %s:%d", motor_ip_, tcp_port_);
+    last_connect_attempt_ = Platform::millis();
+    handshake_.reset(new SomfyPoeHandshake<Platform>(&tcp_client_, motor_ip_, tcp_port_, pin_code_, message_id_));
+    message_id_ += SomfyPoeHandshake<Platform>::MESSAGE_IDS;
+
+    if (handshake_executor_) {
+      handshake_executor_(handshake_.get(), [this]() { complete_handshake(); });
+      return false;
+    }
+    handshake_->run();
+    return complete_handshake();
+  }
+
+  bool complete_handshake() {
+    std::unique_ptr<SomfyPoeHandshake<Platform>> handshake = std::move(handshake_);
+    if (!handshake->succeeded()) {
+      drop_deferred_move();  // Held for this session
+      record_failure("handshake failed");
+      return false;
+    }
+
+    target_id_ = handshake->get_target_id();
+    ESP_LOGI("somfy_poe", "Authenticated! Target ID: %s", target_id_.c_str());
+    codec_.set_key(handshake->get_key());
+    is_authenticated_ = true;
+    session_restored_ = false;
+    ESP_LOGI("somfy_poe", "Successfully authenticated with motor");
+
+    // Request initial position, group memberships and lock state
+    request_position_update();
+    request_group_memberships();
+    request_lock_state();
+
+    record_success();
+    return true;
+  }
+
+  bool is_redundant_move(float target) {
+    if (!is_authenticated_ || !position_settled_) {
+      return false;
+    }
+    if (fabsf(current_position_ - target) > position_tolerance_) {
+      return false;
+    }
+
+    elided_commands_++;
+    ESP_LOGD("somfy_poe", "Already at %.1f%% (target %.1f%%), move elided",
+             current_position_, target);
+    return true;
+  }
+
+  // Serializes a request into `out`. Returns its length, or 0 if it does
+  // not fit in `capacity`. Move commands carry a sequence number (seq != 0)
+  // so the motor can discard retransmitted duplicates.
+  size_t build_request(char* out, size_t capacity, uint32_t id, const char* method,
+                       float position, uint32_t seq, const char* group_id = nullptr) {
+    return somfy_poe_build_request(out, capacity, id, method, target_id_.c_str(), position, seq, group_id);
+  }
+
+  bool submit_move(const char* method, float position) {
+    if (health_ == SomfyPoeHealth::OPEN) {
+      ESP_LOGD("somfy_poe", "Motor unresponsive, rejecting %s", method);
+      return false;
+    }
+    if (!ensure_session() && handshake_ == nullptr) {
+      ESP_LOGW("somfy_poe", "Not authenticated, cannot send command");
+      return false;
+    }
+    last_used_ms_ = Platform::millis();
+
+    if (is_authenticated_ && deferred_method_ == nullptr && rate_limiter_.try_consume(Platform::millis())) {
+      return send_move_command(method, position);
+    }
+
+    if (deferred_method_ != nullptr) {
+      coalesced_commands_++;
+    }
+    ESP_LOGD("somfy_poe", "%s, holding %s", is_authenticated_ ? "Rate limited" : "Handshake pending", method);
+    deferred_method_ = method;
+    deferred_position_ = position;
+    return true;
+  }
+
+  bool send_move_command(const char* method, float position,
+                         const char* group_id = nullptr) {
+    if (!is_authenticated_) {
+      ESP_LOGW("somfy_poe", "Not authenticated, cannot send command");
+      return false;
+    }
+
+    uint32_t id = message_id_++;
+    uint32_t seq = ++move_seq_;
+    char command[MAX_REQUEST_JSON];
+    size_t command_len = build_request(command, sizeof(command), id, method, position, seq,
+                                       group_id);
+    if (command_len == 0) {
+      return false;
+    }
+
+    // The cached position no longer describes where the motor will stop
+    expect_motion();
+
+    // Group commands have no single reply to wait for
+    if (group_id != nullptr) {
+      return send_encrypted_udp(command, command_len, GROUP_BROADCAST_ADDRESS);
+    }
+
+    return send_tracked_request(id, command, command_len, method, seq);
+  }
+
+  bool request_position_update() {
+    return send_query("status.position");
+  }
+
+  bool request_group_memberships() {
+    return send_query("group.get");
+  }
+
+  bool request_lock_state() {
+    return send_query("lock.get");
+  }
+
+  bool send_query(const char* method) {
+    if (!is_authenticated_ || health_ == SomfyPoeHealth::OPEN) {
+      return false;
+    }
+
+    uint32_t id = message_id_++;
+    char query[MAX_REQUEST_JSON];
+    size_t query_len = build_request(query, sizeof(query), id, method, -1.0f, 0);
+    if (query_len == 0) {
+      return false;
+    }
+    return send_tracked_request(id, query, query_len, method, 0);
+  }
+
+  // Sends a unicast request and remembers it until the reply arrives, for
+  // RTT measurement and retransmission. The encrypted packet is kept in a
+  // slab pool buffer so a retransmission is a plain socket write. When the
+  // table is full, the oldest request is forgotten; a forgotten move fails.
+  bool send_tracked_request(uint32_t id, const char* message, size_t message_len,
+                            const char* method, uint32_t seq) {
+    PendingRequest* slot = track_request(id, message, message_len, method, seq);
+    return send_pending(slot);
+  }
+
+  bool send_pending(PendingRequest* slot) {
+    bool sent = send_packet(slot->packet, slot->packet_len, motor_ip_);
+    if (sent) slot->send_id = udp_->last_send_id();
+    return sent;
+  }
+
+  // Encrypts a request into a pending slot without sending it
+  PendingRequest* track_request(uint32_t id, const char* message, size_t message_len,
+                                const char* method, uint32_t seq) {
+    // An armed move is never evicted
+    size_t index = armed_move_ == &pending_[0] ? 1 : 0;
+    for (size_t i = 0; i < MAX_PENDING_REQUESTS; i++) {
+      if (&pending_[i] == armed_move_) continue;
+      if (!pending_[i].active) {
+        index = i;
+        break;
+      }
+      if ((int32_t) (pending_[i].id - pending_[index].id) < 0) index = i;
+    }
+    PendingRequest* slot = &pending_[index];
+    uint32_t evicted_seq = slot->active ? slot->seq : 0;
+    release_request(slot);
+
+    size_t capacity = SomfyPoePacketCodec<Platform>::encrypted_size(message_len);
+    slot->active = true;
+    slot->retransmit = true;
+    slot->armed = false;
+    slot->id = id;
+    slot->method = method;
+    slot->seq = seq;
+    slot->sent_us = Platform::micros();
+    slot->sent_ms = Platform::millis();
+    slot->retries = 0;
+    slot->packet = SomfyPoeSlabPool::instance().allocate(capacity);
+    slot->packet_len = codec_.encrypt(message, message_len, slot->packet, capacity);
+
+    // Reported once the slot is filled, so a callback that sends cannot take it
+    if (evicted_seq != 0) move_result_callback_.call(evicted_seq, false);
+    return slot;
+  }
+
+  // Frees a pending slot and returns its packet buffer to the pool
+  void release_request(PendingRequest* pending) {
+    if (pending->packet != nullptr) {
+      SomfyPoeSlabPool::instance().release(pending->packet);
+      pending->packet = nullptr;
+      pending->packet_len = 0;
+    }
+    pending->active = false;
+    pending->armed = false;
+    if (pending == armed_move_) armed_move_ = nullptr;
+  }
+
+  void complete_request(uint32_t id, bool result) {
+    for (auto& pending : pending_) {
+      if (!pending.active || pending.id != id) continue;
+
+      // Karn's algorithm: a reply to a retransmitted request is ambiguous
+      if (pending.retries == 0) {
+        uint32_t rtt_us = Platform::micros() - pending.sent_us;
+        rtt_.add_sample(rtt_us);
+        rtt_histogram_.add(rtt_us);
+        if (have_receive_times_) record_kernel_times(pending);
+      }
+      rate_limiter_.on_reply();
+      record_success();
+      uint32_t seq = pending.seq;
+      release_request(&pending);
+      if (seq != 0) move_result_callback_.call(seq, result);
+      return;
+    }
+  }
+
+  // Wire RTT uses the NIC's times if it stamped both datagrams
+  void record_kernel_times(const PendingRequest& pending) {
+    uint64_t sent_software_ns;
+    uint64_t sent_hardware_ns;
+    if (!udp_->send_times(pending.send_id, &sent_software_ns, &sent_hardware_ns)) return;
+    if (sent_hardware_ns != 0 && receive_hardware_ns_ > sent_hardware_ns) {
+      wire_rtt_histogram_.add((receive_hardware_ns_ - sent_hardware_ns) / 1000);
+    } else if (sent_software_ns != 0 && receive_software_ns_ > sent_software_ns) {
+      wire_rtt_histogram_.add((receive_software_ns_ - sent_software_ns) / 1000);
+    }
+    if (sent_software_ns != 0) {
+      send_delay_histogram_.add((uint32_t) (sent_software_ns / 1000) - pending.sent_us);
+    }
+  }
+
+  void cancel_pending_moves() {
+    for (auto& pending : pending_) {
+      if (pending.active && !pending.armed && pending.seq != 0 && pending.packet != nullptr) {
+        // Keep waiting for the reply (for RTT) but free the buffer now
+        pending.retransmit = false;
+        SomfyPoeSlabPool::instance().release(pending.packet);
+        pending.packet = nullptr;
+        pending.packet_len = 0;
+      }
+    }
+  }
+
+  // A held move would have been sent with the next sequence number
+  void drop_deferred_move() {
+    if (deferred_method_ == nullptr) return;
+    deferred_method_ = nullptr;
+    move_result_callback_.call(move_seq_ + 1, false);
+  }
+
+  void clear_pending_requests() {
+    drop_deferred_move();
+    for (auto& pending : pending_) {
+      uint32_t seq = pending.active ? pending.seq : 0;
+      release_request(&pending);
+      if (seq != 0) move_result_callback_.call(seq, false);
+    }
+  }
+
+  // Each retransmission doubles the timeout (exponential backoff)
+  void check_retransmits() {
+    if (!is_authenticated_) {
+      return;
+    }
+
+    unsigned long now = Platform::millis();
+    bool session_rejected = false;
+    for (auto& pending : pending_) {
+      if (!pending.active || pending.armed) continue;
+
+      uint32_t timeout = rtt_.get_rto_ms() << pending.retries;
+      if (timeout > SomfyPoeRttEstimator::MAX_RTO_MS) timeout = SomfyPoeRttEstimator::MAX_RTO_MS;
+      if (now - pending.sent_ms < timeout) continue;
+
+      if (!pending.retransmit) {
+        // Superseded and unanswered, nothing left to wait for
+        uint32_t seq = pending.seq;
+        release_request(&pending);
+        if (seq != 0) move_result_callback_.call(seq, false);
+        if (session_restored_) session_rejected = true;
+        continue;
+      }
+
+      rate_limiter_.on_timeout();
+
+      // A degraded motor gets a single retry so it cannot eat the send budget
+      uint8_t max_retransmits = health_ == SomfyPoeHealth::DEGRADED ? 1 : MAX_RETRANSMITS;
+      if (pending.retries >= max_retransmits) {
+        ESP_LOGW("somfy_poe", "No reply to %s (id %u) after %u retransmits",
+                 pending.method, (unsigned) pending.id, (unsigned) pending.retries);
+        timeouts_++;
+        uint32_t seq = pending.seq;
+        release_request(&pending);
+        if (seq != 0) move_result_callback_.call(seq, false);
+        if (session_restored_) {
+          session_rejected = true;  // Counted once below
+          continue;
+        }
+        record_failure("request timed out");
+        continue;
+      }
+
+      ESP_LOGD("somfy_poe", "Retransmitting %s (id %u) after %u ms",
+               pending.method, (unsigned) pending.id, (unsigned) timeout);
+      pending.retries++;
+      pending.sent_ms = now;
+      retransmits_++;
+      send_pending(&pending);
+    }
+
+    // Nothing readable from the motor since the session was restored, so it
+    // has been rekeyed or is down. One failure for the breaker either way;
+    // unless that isolates the motor, a handshake tells the two apart.
+    if (session_rejected) {
+      session_restored_ = false;
+      record_failure("cached session not accepted");
+      if (health_ == SomfyPoeHealth::OPEN) return;
+      ESP_LOGW("somfy_poe", "Cached session for %s not accepted, re-authenticating", motor_ip_);
+      reconnect();
+    }
+  }
+
+  void report_state_change() {
+    if (health_ == reported_health_ && is_authenticated_ == reported_authenticated_) return;
+    reported_health_ = health_;
+    reported_authenticated_ = is_authenticated_;
+    state_callback_.call();
+  }
+
+  void record_success() {
+    if (health_ != SomfyPoeHealth::HEALTHY) {
+      ESP_LOGI("somfy_poe", "Motor at %s recovered", motor_ip_);
+    }
+    consecutive_failures_ = 0;
+    health_ = SomfyPoeHealth::HEALTHY;
+    probe_interval_ms_ = PROBE_MIN_INTERVAL_MS;
+  }
+
+  void record_failure(const char* reason) {
+    if (consecutive_failures_ < 255) consecutive_failures_++;
+
+    if (health_ == SomfyPoeHealth::OPEN) {
+      return;
+    }
+    if (consecutive_failures_ >= OPEN_AFTER_FAILURES) {
+      ESP_LOGW("somfy_poe", "Motor at %s unresponsive (%s), isolating", motor_ip_, reason);
+      health_ = SomfyPoeHealth::OPEN;
+      clear_pending_requests();
+      next_probe_ms_ = Platform::millis() + probe_interval_ms_;
+    } else if (consecutive_failures_ >= DEGRADED_AFTER_FAILURES) {
+      health_ = SomfyPoeHealth::DEGRADED;
+    }
+  }
+
+  // Checks reachability with a plain TCP connect (no TLS) before spending a
+  // full handshake. Unreachable motors are probed with exponential backoff.
+  void probe() {
+    bool reachable = Platform::probe(motor_ip_, tcp_port_, PROBE_TIMEOUT_MS);
+
+    if (reachable) {
+      // Half-open: one real handshake decides whether to close the breaker
+      ESP_LOGD("somfy_poe", "Motor at %s reachable again, re-authenticating", motor_ip_);
+      is_authenticated_ = false;
+      if (connect_and_authenticate()) {
+        return;
+      }
+    }
+
+    probe_interval_ms_ = std::min(probe_interval_ms_ * 2, PROBE_MAX_INTERVAL_MS);
+    next_probe_ms_ = Platform::millis() + probe_interval_ms_;
+  }
+
+  bool send_encrypted_udp(const char* message, size_t message_len, const char* host) {
+    SomfyPoeSlabPool& pool = SomfyPoeSlabPool::instance();
+    size_t capacity = SomfyPoePacketCodec<Platform>::encrypted_size(message_len);
+    uint8_t* packet = pool.allocate(capacity);
+    size_t packet_len = codec_.encrypt(message, message_len, packet, capacity);
+    bool success = send_packet(packet, packet_len, host);
+    pool.release(packet);
+    return success;
+  }
+
+  bool send_packet(const uint8_t* packet, size_t packet_len, const char* host) {
+    return udp_ != nullptr && udp_->send_to(host, udp_port_, packet, packet_len);
+  }
+
+  // A datagram from this motor's address, read by the socket's poll(). The
+  // buffer is decrypted in place.
+  void receive_datagram(uint8_t* buffer, int packet_size) {
+    have_receive_times_ =
+        kernel_timestamps_ && udp_->receive_times(&receive_software_ns_, &receive_hardware_ns_);
+    if (have_receive_times_) {
+      receive_delay_histogram_.add(Platform::micros() - (uint32_t) (receive_software_ns_ / 1000));
+    }
+
+    size_t message_len = 0;
+    const char* message = codec_.decrypt(buffer, packet_size, &message_len);
+    if (message == nullptr) {
+      ESP_LOGW("somfy_poe", "UDP packet of %d bytes has invalid size or padding", packet_size);
+      return;
+    }
+
+    // Parse JSON response straight from the decrypted buffer
+    StaticJsonDocument<1024> doc;
+    DeserializationError error = deserializeJson(doc, message, message_len);
+
+    if (!error) {
+      session_restored_ = false;  // The motor speaks the cached key
+      process_response(doc);
+    } else {
+      ESP_LOGW("somfy_poe", "Failed to parse UDP response: %s", error.c_str());
+    }
+  }
+
+  void restore_snapshot() {
+    snapshot_preference_ = global_preferences->make_preference<StateSnapshot>(
+        fnv1_hash(std::string("somfy_poe_state_") + motor_ip_));
+    if (!snapshot_preference_.load(&snapshot_)) {
+      snapshot_ = {-1.0f, -1};
+      return;
+    }
+
+    if (snapshot_.locked == 0 || snapshot_.locked == 1) {
+      locked_ = snapshot_.locked;
+      lock_stale_ = true;
+      lock_callback_.call(locked_ == 1);
+    } else {
+      snapshot_.locked = -1;
+    }
+
+    if (snapshot_.position < 0.0f || snapshot_.position > 100.0f) {
+      snapshot_.position = -1.0f;
+      return;
+    }
+
+    // Published right away, but never trusted for eliding moves
+    current_position_ = snapshot_.position;
+    strncpy(current_status_, "stale", sizeof(current_status_) - 1);
+    position_stale_ = true;
+    ESP_LOGD("somfy_poe", "Restored position %.1f%% for %s", current_position_, motor_ip_);
+    position_callback_.call(current_position_, false);
+  }
+
+  void save_snapshot() {
+    if (!snapshot_dirty_ || Platform::millis() - last_snapshot_ms_ < SNAPSHOT_MIN_INTERVAL_MS) return;
+
+    snapshot_.position = current_position_;
+    snapshot_.locked = locked_;
+    snapshot_preference_.save(&snapshot_);
+    snapshot_dirty_ = false;
+    last_snapshot_ms_ = Platform::millis();
+  }
+
+  void process_response(JsonDocument& doc) {
+    const char* method = doc["method"];
+
+    // Replies echo the request id; unsolicited pushes are not correlated
+    if (doc.containsKey("id")) {
+      complete_request(doc["id"].as<uint32_t>(), doc["result"] | true);
+    }
+
+    // Check if this is a position update
+    if (doc.containsKey("position")) {
+      JsonObject pos = doc["position"];
+      current_position_ = pos["value"].as<float>();
+      const char* direction_name = pos["direction"] | "stopped";
+      strncpy(current_status_, direction_name, sizeof(current_status_) - 1);
+      current_status_[sizeof(current_status_) - 1] = '\0';
+
+      int direction = strcmp(current_status_, "up") == 0     ? -1
+                      : strcmp(current_status_, "down") == 0 ? 1
+                                                             : 0;
+      travel_model_.on_report(Platform::millis(), current_position_, direction);
+      position_settled_ = direction == 0 && Platform::millis() - last_move_sent_ > MOVE_SETTLE_MS;
+      position_stale_ = false;
+      history_.add(Platform::millis(), current_position_);
+      if (direction == 0 && fabsf(current_position_ - snapshot_.position) >= SNAPSHOT_MIN_CHANGE) {
+        snapshot_dirty_ = true;
+      }
+
+      ESP_LOGD("somfy_poe", "Position: %.1f%%, Status: %s",
+               current_position_, current_status_);
+
+      position_callback_.call(current_position_, direction != 0);
+    }
+
+    // Lock state (reply to lock.get)
+    if (doc.containsKey("lock")) {
+      locked_ = doc["lock"].as<bool>() ? 1 : 0;
+      lock_stale_ = false;
+      if (locked_ != snapshot_.locked) snapshot_dirty_ = true;
+
+      ESP_LOGD("somfy_poe", "Lock: %s", locked_ == 1 ? "locked" : "unlocked");
+
+      lock_callback_.call(locked_ == 1);
+    }
+
+    // Group memberships (reply to group.get)
+    if (doc.containsKey("group")) {
+      groups_.clear();
+      for (JsonVariant group : doc["group"].as<JsonArray>()) {
+        groups_.push_back(group.as<std::string>());
+      }
+      groups_known_ = true;
+
+      ESP_LOGD("somfy_poe", "Member of %u group(s)", (unsigned) groups_.size());
+
+      groups_callback_.call(groups_);
+    }
+
+    // Log result status
+    if (doc.containsKey("result")) {
       bool result = doc["result"].as<bool>();
       if (!result) {
         ESP_LOGW("somfy_poe", "Command failed");
@@ -412,5 +1975,7 @@ class SomfyPoeMotor : public Component {
   }
 };
 
+using SomfyPoeMotor = SomfyPoeMotorBase<SomfyPoeDefaultPlatform>;
+
 }  // namespace somfy_poe
 }  // namespace esphome
@@ -0,0 +1,776 @@
+/*
+ * ESPHome Hub for multiple Somfy PoE Motors
+ *
+ * The hub knows every SomfyPoeMotor on this controller and coordinates
+ * operations that span motors. Scenes are planned so that motors sharing a
+ * target are moved with a single group command where the motors' group
+ * memberships (from group.get) allow it, falling back to per-motor
+ * commands for the rest.
+ *
+ * The hub also keeps running aggregates per group (motors moving, average,
+ * minimum and maximum position). Each position report adjusts only the
+ * groups of the reporting motor, so group state is O(1) per update no
+ * matter how many motors the controller has.
+ *
+ * Scenes can optionally be synchronized so that motions finish together:
+ * each motor's send is delayed by the difference between its predicted
+ * travel time (from its learned travel model) and the slowest motor's.
+ *
+ * For large fleets the hub can cap the number of open motor sessions.
+ * Motors then connect on their first command, and the least recently used
+ * idle session is closed when the cap or a free-heap floor is reached.
+ *
+ * Scenes can also be armed for an absolute (SNTP) time, so controllers
+ * sharing a room start their motors together: packets are encrypted when
+ * armed and written back to back at the agreed instant.
+ *
+ * All motors on the hub share one UDP socket, owned and polled by the hub,
+ * which routes each reply to the motor it came from.
+ *
+ * Requires somfy_poe_component.h.
+ */
+
+#pragma once
+
+#include "somfy_poe_component.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+struct SomfyPoeSceneTarget {
+  SomfyPoeMotor* motor;
+  float position;  // 0 = open, 100 = closed
+};
+
+struct SomfyPoeScenePlan {
+  struct GroupSend {
+    std::string group;
+    float position;
+    SomfyPoeMotor* key_holder;  // Authenticated member whose key encrypts the send
+    std::vector<SomfyPoeMotor*> members;
+  };
+
+  std::vector<GroupSend> group_sends;
+  std::vector<SomfyPoeSceneTarget> unicast_sends;
+
+  // One packet per motor, as if every target were sent individually
+  size_t naive_packets = 0;
+
+  size_t planned_packets() const {
+    return group_sends.size() + unicast_sends.size();
+  }
+
+  size_t packets_saved() const {
+    return naive_packets - planned_packets();
+  }
+};
+
+class SomfyPoeHub : public Component, public api::CustomAPIDevice {
+ public:
+  SomfyPoeHub()
+    : use_groups_(true),
+      scenes_applied_(0),
+      packets_saved_(0),
+      max_sessions_(0),
+      min_free_heap_(0),
+      session_evictions_(0),
+      armed_at_us_(0),
+      last_skew_us_(0),
+      last_spread_us_(0) {
+  }
+
+  // Runs after the motors, so their UDP sockets exist when prewarming
+  float get_setup_priority() const override {
+    return setup_priority::LATE;
+  }
+
+  void setup() override {
+    for (SomfyPoeMotor* motor : prewarm_) {
+      motor->ensure_session();
+    }
+
+    register_service(&SomfyPoeHub::on_get_history, "somfy_get_history", {"ip"});
+  }
+
+  void add_motor(SomfyPoeMotor* motor) {
+    motors_.push_back(motor);
+    motor->set_udp_socket(&udp_);
+    if (max_sessions_ > 0) {
+      make_lazy(motor);
+    }
+
+    records_.emplace_back(new MotorRecord());
+    MotorRecord* record = records_.back().get();
+    record->index = motors_.size() - 1;
+    motor->add_on_position_callback([this, record](float position, bool moving) {
+      this->on_motor_position(record, position, moving);
+      this->motor_changed_callback_.call(record->index);
+    });
+    motor->add_on_state_callback([this, record]() { this->motor_changed_callback_.call(record->index); });
+    motor->add_on_lock_callback([this, record](bool) { this->motor_changed_callback_.call(record->index); });
+    motor->add_on_groups_callback([this, record](const std::vector<std::string>& groups) {
+      this->on_motor_groups(record, groups);
+    });
+    motor_changed_callback_.call(record->index);
+  }
+
+  // Withdraws a motor from scenes, sessions, group aggregates and the
+  // hub's socket, and tells the motor-removed callbacks. Its callbacks
+  // still point at the hub, so the motor must be deleted after.
+  void remove_motor(SomfyPoeMotor* motor) {
+    auto it = std::find(motors_.begin(), motors_.end(), motor);
+    if (it == motors_.end()) return;
+    motor_removed_callback_.call(motor);
+
+    size_t index = it - motors_.begin();
+    on_motor_groups(records_[index].get(), {});
+
+    motor->set_udp_socket(nullptr);
+    motors_.erase(it);
+    records_.erase(records_.begin() + index);
+    for (size_t i = index; i < records_.size(); i++) records_[i]->index = i;
+    prewarm_.erase(std::remove(prewarm_.begin(), prewarm_.end(), motor), prewarm_.end());
+    armed_.erase(std::remove(armed_.begin(), armed_.end(), motor), armed_.end());
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE Hub: %u motor(s)", (unsigned) motors_.size());
+
+    const SomfyPoeSlabPool& pool = SomfyPoeSlabPool::instance();
+    for (size_t c = 0; c < SomfyPoeSlabPool::NUM_CLASSES; c++) {
+      ESP_LOGCONFIG("somfy_poe", "  Slab %4u B: %u/%u in use, high water %u",
+                    (unsigned) pool.get_slot_size(c), (unsigned) pool.get_in_use(c),
+                    (unsigned) pool.get_slot_count(c), (unsigned) pool.get_high_water(c));
+    }
+    ESP_LOGCONFIG("somfy_poe", "  Slab exhaustions: %u", (unsigned) pool.get_exhaustion_count());
+    ESP_LOGCONFIG("somfy_poe", "  UDP datagrams from unknown senders: %u", (unsigned) udp_.get_unrouted_count());
+
+    if (max_sessions_ > 0) {
+      ESP_LOGCONFIG("somfy_poe", "  Sessions: %u/%u open, %u eviction(s)",
+                    (unsigned) get_session_count(), (unsigned) max_sessions_,
+                    (unsigned) session_evictions_);
+    }
+  }
+
+  const std::vector<SomfyPoeMotor*>& get_motors() const {
+    return motors_;
+  }
+
+  // Called from remove_motor(), so components holding the motor (schedules,
+  // shading) drop it before it is deleted
+  void add_on_motor_removed_callback(std::function<void(SomfyPoeMotor*)>&& callback) {
+    motor_removed_callback_.add(std::move(callback));
+  }
+
+  // Called with a motor's index in get_motors() when it is added and on
+  // every position or lock report, health or session change, so state can
+  // be republished per motor instead of by scanning them all. Removing a
+  // motor shifts the indices after it (see add_on_motor_removed_callback()).
+  void add_on_motor_changed_callback(std::function<void(size_t)>&& callback) {
+    motor_changed_callback_.add(std::move(callback));
+  }
+
+  // Group sends assume every member of a group is registered with this hub.
+  // Disable them if groups span motors controlled from elsewhere.
+  void set_use_groups(bool use_groups) {
+    use_groups_ = use_groups;
+  }
+
+  // Caps the number of motors with an open TLS session and AES key. Once
+  // set, motors connect lazily on their first command; 0 disables the cap.
+  // Call before or after add_motor(), but before setup().
+  void set_max_sessions(size_t max_sessions) {
+    max_sessions_ = max_sessions;
+    if (max_sessions_ > 0) {
+      for (SomfyPoeMotor* motor : motors_) {
+        make_lazy(motor);
+      }
+    }
+  }
+
+  // Also evict idle sessions while free heap is below this many bytes
+  void set_min_free_heap(uint32_t bytes) {
+    min_free_heap_ = bytes;
+  }
+
+  // Connects this motor at boot instead of on its first command
+  void add_prewarm(SomfyPoeMotor* motor) {
+    prewarm_.push_back(motor);
+  }
+
+  size_t get_session_count() const {
+    size_t sessions = 0;
+    for (SomfyPoeMotor* motor : motors_) {
+      if (motor->is_authenticated()) sessions++;
+    }
+    return sessions;
+  }
+
+  uint32_t get_session_eviction_count() const {
+    return session_evictions_;
+  }
+
+  // Computes a near-minimal set of group and per-motor sends for a scene.
+  //
+  // A group is only used for a target if every motor known to be in it
+  // wants exactly that target, so no motor is ever moved somewhere it was
+  // not asked to go. Among the usable groups, the one covering the most
+  // still-uncovered motors is picked greedily (the classic set cover
+  // approximation); motors left over are sent individually.
+  SomfyPoeScenePlan plan_scene(const std::vector<SomfyPoeSceneTarget>& targets) const {
+    SomfyPoeScenePlan plan;
+
+    // Deduplicate motors, the last target for a motor wins
+    std::map<SomfyPoeMotor*, float> wanted;
+    for (const auto& target : targets) {
+      wanted[target.motor] = clamp_position(target.position);
+    }
+    plan.naive_packets = wanted.size();
+
+    // Bucket motors by target, quantized to 0.1% so equal targets match
+    std::map<int, std::vector<SomfyPoeMotor*>> by_target;
+    for (const auto& entry : wanted) {
+      by_target[quantize(entry.second)].push_back(entry.first);
+    }
+
+    std::map<std::string, std::vector<SomfyPoeMotor*>> groups;
+    if (use_groups_ && all_memberships_known()) {
+      groups = build_group_index();
+    }
+
+    for (auto& bucket : by_target) {
+      float position = bucket.first / 10.0f;
+      std::vector<SomfyPoeMotor*>& motors = bucket.second;
+      std::vector<bool> covered(motors.size(), false);
+
+      // Groups whose members all want this target
+      std::vector<const std::pair<const std::string, std::vector<SomfyPoeMotor*>>*> usable;
+      for (const auto& group : groups) {
+        if (group.second.size() >= 2 && is_subset(group.second, motors)) {
+          usable.push_back(&group);
+        }
+      }
+
+      while (!usable.empty()) {
+        size_t best = 0;
+        size_t best_gain = 0;
+        for (size_t i = 0; i < usable.size(); i++) {
+          size_t gain = 0;
+          for (SomfyPoeMotor* member : usable[i]->second) {
+            if (!covered[index_of(motors, member)]) gain++;
+          }
+          if (gain > best_gain) {
+            best = i;
+            best_gain = gain;
+          }
+        }
+
+        // A group covering a single new motor costs the same as a unicast
+        if (best_gain < 2) break;
+
+        SomfyPoeMotor* key_holder = nullptr;
+        for (SomfyPoeMotor* member : usable[best]->second) {
+          if (member->is_authenticated()) {
+            key_holder = member;
+            break;
+          }
+        }
+
+        if (key_holder != nullptr) {
+          SomfyPoeScenePlan::GroupSend send;
+          send.group = usable[best]->first;
+          send.position = position;
+          send.key_holder = key_holder;
+          send.members = usable[best]->second;
+          for (SomfyPoeMotor* member : send.members) {
+            covered[index_of(motors, member)] = true;
+          }
+          plan.group_sends.push_back(send);
+        }
+        usable.erase(usable.begin() + best);
+      }
+
+      for (size_t i = 0; i < motors.size(); i++) {
+        if (!covered[i]) {
+          plan.unicast_sends.push_back({motors[i], position});
+        }
+      }
+    }
+
+    return plan;
+  }
+
+  // Plans and sends a scene. Returns false if any send failed; `accepted`,
+  // if given, receives whether each target's send succeeded.
+  //
+  // With synchronize_finish, motors are sent individually with per-motor
+  // offsets so that they all arrive at about the same time; the result
+  // then only reflects the sends made immediately.
+  bool apply_scene(const std::vector<SomfyPoeSceneTarget>& targets,
+                   bool synchronize_finish = false, std::vector<bool>* accepted = nullptr) {
+    if (synchronize_finish) {
+      return apply_synchronized_scene(targets, accepted);
+    }
+
+    SomfyPoeScenePlan plan = plan_scene(targets);
+    bool success = true;
+    std::map<SomfyPoeMotor*, bool> sent;  // Only kept for `accepted`
+
+    for (const auto& send : plan.group_sends) {
+      bool ok = send.key_holder->send_group_command(send.group.c_str(), "move.to", send.position);
+      for (SomfyPoeMotor* member : send.members) {
+        if (ok) member->expect_motion();
+        if (accepted != nullptr) sent[member] = ok;
+      }
+      success &= ok;
+    }
+
+    for (const auto& send : plan.unicast_sends) {
+      bool ok = send.motor->move_to_position(send.position);
+      if (accepted != nullptr) sent[send.motor] = ok;
+      success &= ok;
+    }
+
+    if (accepted != nullptr) {
+      accepted->clear();
+      for (const auto& target : targets) accepted->push_back(sent[target.motor]);
+    }
+
+    scenes_applied_++;
+    packets_saved_ += plan.packets_saved();
+
+    ESP_LOGD("somfy_poe", "Scene: %u motor(s) in %u group + %u direct send(s)",
+             (unsigned) plan.naive_packets, (unsigned) plan.group_sends.size(),
+             (unsigned) plan.unicast_sends.size());
+
+    return success;
+  }
+
+  // Arms a scene to start at an absolute time (Unix ms, e.g. agreed with
+  // other controllers). Every motor's move is encrypted now and sent
+  // individually at that instant. Needs the system clock set by SNTP; a
+  // newly armed scene replaces one still waiting.
+  bool apply_scene_at(const std::vector<SomfyPoeSceneTarget>& targets, int64_t unix_ms) {
+    int64_t now = unix_time_us();
+    if (now < MIN_VALID_TIME_US) {
+      ESP_LOGW("somfy_poe", "Clock not synchronized, cannot arm scene");
+      return false;
+    }
+    disarm_scene();
+
+    bool success = true;
+    for (const auto& target : targets) {
+      if (target.motor->arm_move_to_position(clamp_position(target.position))) {
+        armed_.push_back(target.motor);
+      } else {
+        success = false;
+      }
+    }
+    if (armed_.empty()) return false;
+
+    armed_at_us_ = unix_ms * 1000;
+    high_frequency_.start();
+    ESP_LOGD("somfy_poe", "Scene armed for %u motor(s) in %d ms", (unsigned) armed_.size(),
+             (int) ((armed_at_us_ - now) / 1000));
+    return success;
+  }
+
+  void disarm_scene() {
+    for (SomfyPoeMotor* motor : armed_) {
+      motor->disarm_move();
+    }
+    armed_.clear();
+    armed_at_us_ = 0;
+    high_frequency_.stop();
+  }
+
+  // Of the last timed scene: how late the first packet left (us) and the
+  // time from the first to the last packet (us)
+  int32_t get_last_send_skew_us() const {
+    return last_skew_us_;
+  }
+
+  int32_t get_last_send_spread_us() const {
+    return last_spread_us_;
+  }
+
+  void loop() override {
+    udp_.poll();
+    if (armed_at_us_ != 0) fire_armed_scene();
+  }
+
+  // The socket shared by the hub's motors
+  SomfyPoeUdpSocket<SomfyPoeDefaultPlatform>& get_udp_socket() {
+    return udp_;
+  }
+
+  uint32_t get_scenes_applied() const {
+    return scenes_applied_;
+  }
+
+  // Packets avoided by group sends across all applied scenes
+  uint32_t get_packets_saved() const {
+    return packets_saved_;
+  }
+
+  // Group aggregates. Position getters return NAN until a member reports.
+  uint16_t get_group_moving_count(const std::string& group) const {
+    const GroupAggregate* aggregate = find_aggregate(group);
+    return aggregate != nullptr ? aggregate->moving : 0;
+  }
+
+  bool is_group_moving(const std::string& group) const {
+    return get_group_moving_count(group) > 0;
+  }
+
+  float get_group_average_position(const std::string& group) const {
+    const GroupAggregate* aggregate = find_aggregate(group);
+    if (aggregate == nullptr || aggregate->reporting == 0) return NAN;
+    return aggregate->position_sum / aggregate->reporting;
+  }
+
+  float get_group_min_position(const std::string& group) const {
+    const GroupAggregate* aggregate = find_aggregate(group);
+    if (aggregate == nullptr || aggregate->reporting == 0) return NAN;
+    return aggregate->min_bucket;
+  }
+
+  float get_group_max_position(const std::string& group) const {
+    const GroupAggregate* aggregate = find_aggregate(group);
+    if (aggregate == nullptr || aggregate->reporting == 0) return NAN;
+    return aggregate->max_bucket;
+  }
+
+  // Publishes the group's aggregates to these sensors whenever they change.
+  // Any sensor may be nullptr.
+  void set_group_sensors(const std::string& group, sensor::Sensor* moving_count,
+                         sensor::Sensor* average_position,
+                         sensor::Sensor* min_position = nullptr,
+                         sensor::Sensor* max_position = nullptr) {
+    GroupAggregate& aggregate = aggregates_[group];
+    aggregate.moving_sensor = moving_count;
+    aggregate.average_sensor = average_position;
+    aggregate.min_sensor = min_position;
+    aggregate.max_sensor = max_position;
+  }
+
+ private:
+  // Positions are whole-percent buckets for min/max tracking; the sum (and
+  // therefore the average) uses the exact reported values.
+  static const int POSITION_BUCKETS = 101;
+
+  struct GroupAggregate {
+    uint16_t members = 0;
+    uint16_t reporting = 0;  // Members with a known position
+    uint16_t moving = 0;
+    float position_sum = 0.0f;
+    int min_bucket = POSITION_BUCKETS;
+    int max_bucket = -1;
+    uint16_t histogram[POSITION_BUCKETS] = {};
+
+    sensor::Sensor* moving_sensor = nullptr;
+    sensor::Sensor* average_sensor = nullptr;
+    sensor::Sensor* min_sensor = nullptr;
+    sensor::Sensor* max_sensor = nullptr;
+  };
+
+  // Last values the hub folded into the aggregates for one motor
+  struct MotorRecord {
+    size_t index = 0;        // In motors_
+    float position = -1.0f;  // -1 = unknown
+    bool moving = false;
+    std::vector<GroupAggregate*> groups;
+  };
+
+  std::vector<std::unique_ptr<MotorRecord>> records_;
+  std::map<std::string, GroupAggregate> aggregates_;
+
+  std::vector<SomfyPoeMotor*> motors_;
+  SomfyPoeUdpSocket<SomfyPoeDefaultPlatform> udp_;
+  CallbackManager<void(SomfyPoeMotor*)> motor_removed_callback_;
+  CallbackManager<void(size_t)> motor_changed_callback_;
+  bool use_groups_;
+  uint32_t scenes_applied_;
+  uint32_t packets_saved_;
+
+  static int64_t unix_time_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+  }
+
+  void fire_armed_scene() {
+    int64_t now = unix_time_us();
+    if (armed_at_us_ - now > SPIN_US) return;
+    while (now < armed_at_us_) now = unix_time_us();
+
+    int64_t first = now;
+    size_t sent = 0;
+    for (SomfyPoeMotor* motor : armed_) {
+      if (motor->fire_armed_move()) sent++;
+    }
+    int64_t last = unix_time_us();
+
+    last_skew_us_ = (int32_t) (first - armed_at_us_);
+    last_spread_us_ = (int32_t) (last - first);
+    ESP_LOGI("somfy_poe", "Timed scene: %u/%u sent, %d us late, %d us spread", (unsigned) sent,
+             (unsigned) armed_.size(), (int) last_skew_us_, (int) last_spread_us_);
+
+    armed_.clear();
+    armed_at_us_ = 0;
+    high_frequency_.stop();
+    scenes_applied_++;
+  }
+
+  std::vector<SomfyPoeMotor*> prewarm_;
+  size_t max_sessions_;
+  uint32_t min_free_heap_;
+  uint32_t session_evictions_;
+
+  // Timed scenes. The loop runs at full speed while one is armed and spins
+  // for the last SPIN_US to hit the start time within microseconds.
+  static const int64_t SPIN_US = 3000;
+  static const int64_t MIN_VALID_TIME_US = 1600000000LL * 1000000;  // Sep 2020
+  std::vector<SomfyPoeMotor*> armed_;
+  int64_t armed_at_us_;
+  int32_t last_skew_us_;
+  int32_t last_spread_us_;
+  HighFrequencyLoopRequester high_frequency_;
+
+  // Answers with an esphome.somfy_history event carrying the motor's
+  // position history in one payload (see SomfyPoeHistory::encode())
+  void on_get_history(std::string ip) {
+    for (SomfyPoeMotor* motor : motors_) {
+      if (ip != motor->get_motor_ip()) continue;
+      fire_homeassistant_event("esphome.somfy_history",
+                               {{"ip", ip},
+                                {"now", std::to_string(millis())},
+                                {"samples", motor->get_history().encode()}});
+      return;
+    }
+    ESP_LOGW("somfy_poe", "History requested for unknown motor %s", ip.c_str());
+  }
+
+  void make_lazy(SomfyPoeMotor* motor) {
+    motor->set_lazy_session(true);
+    motor->set_session_admission_callback([this](SomfyPoeMotor* requester) {
+      this->make_room(requester);
+    });
+  }
+
+  bool needs_room() const {
+    if (get_session_count() >= max_sessions_) return true;
+    return min_free_heap_ > 0 && SomfyPoeDefaultPlatform::free_heap() < min_free_heap_;
+  }
+
+  // Closes least recently used idle sessions until the requester fits.
+  // Motors with requests in flight or in motion are never evicted; if none
+  // can be, the requester connects anyway and the cap is exceeded briefly.
+  void make_room(SomfyPoeMotor* requester) {
+    while (needs_room()) {
+      SomfyPoeMotor* victim = nullptr;
+      for (SomfyPoeMotor* motor : motors_) {
+        if (motor == requester || !motor->is_authenticated() || !motor->is_idle()) continue;
+        if (victim == nullptr || (long) (motor->get_last_used() - victim->get_last_used()) < 0) {
+          victim = motor;
+        }
+      }
+
+      if (victim == nullptr) {
+        ESP_LOGW("somfy_poe", "No idle session to evict for %s", requester->get_motor_ip());
+        return;
+      }
+
+      ESP_LOGD("somfy_poe", "Evicting idle session with %s", victim->get_motor_ip());
+      victim->close_session();
+      session_evictions_++;
+    }
+  }
+
+  static float clamp_position(float position) {
+    if (position < 0.0f) return 0.0f;
+    if (position > 100.0f) return 100.0f;
+    return position;
+  }
+
+  static int quantize(float position) {
+    return (int) lroundf(position * 10.0f);
+  }
+
+  // A motor whose memberships are unknown could be in any group, so group
+  // sends are only safe once every motor has answered group.get.
+  bool all_memberships_known() const {
+    for (SomfyPoeMotor* motor : motors_) {
+      if (!motor->has_group_memberships()) return false;
+    }
+    return true;
+  }
+
+  std::map<std::string, std::vector<SomfyPoeMotor*>> build_group_index() const {
+    std::map<std::string, std::vector<SomfyPoeMotor*>> groups;
+    for (SomfyPoeMotor* motor : motors_) {
+      for (const std::string& group : motor->get_groups()) {
+        groups[group].push_back(motor);
+      }
+    }
+    return groups;
+  }
+
+  static bool is_subset(const std::vector<SomfyPoeMotor*>& members,
+                        const std::vector<SomfyPoeMotor*>& motors) {
+    for (SomfyPoeMotor* member : members) {
+      if (std::find(motors.begin(), motors.end(), member) == motors.end()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static size_t index_of(const std::vector<SomfyPoeMotor*>& motors, SomfyPoeMotor* motor) {
+    return std::find(motors.begin(), motors.end(), motor) - motors.begin();
+  }
+
+  bool apply_synchronized_scene(const std::vector<SomfyPoeSceneTarget>& targets, std::vector<bool>* accepted) {
+    std::vector<uint32_t> durations;
+    uint32_t longest = 0;
+    for (const auto& target : targets) {
+      uint32_t duration = target.motor->predict_move_duration_ms(clamp_position(target.position));
+      durations.push_back(duration);
+      longest = std::max(longest, duration);
+    }
+
+    bool success = true;
+    if (accepted != nullptr) accepted->assign(targets.size(), true);
+    for (size_t i = 0; i < targets.size(); i++) {
+      SomfyPoeMotor* motor = targets[i].motor;
+      float position = clamp_position(targets[i].position);
+      uint32_t offset = longest - durations[i];
+
+      if (offset == 0) {
+        bool ok = motor->move_to_position(position);
+        if (accepted != nullptr) (*accepted)[i] = ok;
+        success &= ok;
+      } else {
+        this->set_timeout(offset, [this, motor, position]() {
+          // The motor may have been removed from the registry meanwhile
+          if (std::find(motors_.begin(), motors_.end(), motor) != motors_.end()) {
+            motor->move_to_position(position);
+          }
+        });
+      }
+    }
+
+    scenes_applied_++;
+    ESP_LOGD("somfy_poe", "Synchronized scene: %u motor(s), finishing in ~%u ms",
+             (unsigned) targets.size(), (unsigned) longest);
+
+    return success;
+  }
+
+  const GroupAggregate* find_aggregate(const std::string& group) const {
+    auto it = aggregates_.find(group);
+    return it != aggregates_.end() ? &it->second : nullptr;
+  }
+
+  static int bucket_of(float position) {
+    int bucket = (int) lroundf(position);
+    if (bucket < 0) return 0;
+    if (bucket >= POSITION_BUCKETS) return POSITION_BUCKETS - 1;
+    return bucket;
+  }
+
+  static void add_position(GroupAggregate* aggregate, float position) {
+    int bucket = bucket_of(position);
+    aggregate->reporting++;
+    aggregate->position_sum += position;
+    aggregate->histogram[bucket]++;
+    aggregate->min_bucket = std::min(aggregate->min_bucket, bucket);
+    aggregate->max_bucket = std::max(aggregate->max_bucket, bucket);
+  }
+
+  // Removing the current extreme rescans at most POSITION_BUCKETS entries,
+  // a fixed bound independent of group size
+  static void remove_position(GroupAggregate* aggregate, float position) {
+    int bucket = bucket_of(position);
+    aggregate->reporting--;
+    aggregate->position_sum -= position;
+    aggregate->histogram[bucket]--;
+
+    if (aggregate->reporting == 0) {
+      aggregate->position_sum = 0.0f;  // Drop accumulated rounding error
+      aggregate->min_bucket = POSITION_BUCKETS;
+      aggregate->max_bucket = -1;
+      return;
+    }
+    if (aggregate->histogram[bucket] > 0) return;
+    if (bucket == aggregate->min_bucket) {
+      while (aggregate->histogram[aggregate->min_bucket] == 0) aggregate->min_bucket++;
+    }
+    if (bucket == aggregate->max_bucket) {
+      while (aggregate->histogram[aggregate->max_bucket] == 0) aggregate->max_bucket--;
+    }
+  }
+
+  static void publish(GroupAggregate* aggregate) {
+    if (aggregate->moving_sensor != nullptr) {
+      aggregate->moving_sensor->publish_state(aggregate->moving);
+    }
+    if (aggregate->reporting == 0) return;
+    if (aggregate->average_sensor != nullptr) {
+      aggregate->average_sensor->publish_state(aggregate->position_sum / aggregate->reporting);
+    }
+    if (aggregate->min_sensor != nullptr) {
+      aggregate->min_sensor->publish_state(aggregate->min_bucket);
+    }
+    if (aggregate->max_sensor != nullptr) {
+      aggregate->max_sensor->publish_state(aggregate->max_bucket);
+    }
+  }
+
+  void on_motor_position(MotorRecord* record, float position, bool moving) {
+    bool position_changed = position != record->position;
+    if (!position_changed && moving == record->moving) return;
+
+    for (GroupAggregate* aggregate : record->groups) {
+      if (position_changed) {
+        if (record->position >= 0.0f) remove_position(aggregate, record->position);
+        add_position(aggregate, position);
+      }
+      aggregate->moving += (int) moving - (int) record->moving;
+      publish(aggregate);
+    }
+
+    record->position = position;
+    record->moving = moving;
+  }
+
+  void on_motor_groups(MotorRecord* record, const std::vector<std::string>& groups) {
+    // Withdraw the motor from its previous groups, then join the new ones
+    for (GroupAggregate* aggregate : record->groups) {
+      aggregate->members--;
+      aggregate->moving -= record->moving;
+      if (record->position >= 0.0f) remove_position(aggregate, record->position);
+      publish(aggregate);
+    }
+    record->groups.clear();
+
+    for (const std::string& group : groups) {
+      GroupAggregate* aggregate = &aggregates_[group];
+      aggregate->members++;
+      aggregate->moving += record->moving;
+      if (record->position >= 0.0f) add_position(aggregate, record->position);
+      record->groups.push_back(aggregate);
+      publish(aggregate);
+    }
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,399 @@
+/*
+ * Platform policies for the Somfy PoE protocol implementation
+ *
+ * SomfyPoeMotorBase is a template over one of these policy classes, which
+ * supply everything platform specific: the TLS client for the handshake,
+ * the UDP socket, the clock, random numbers and AES-128-CBC. All members
+ * are resolved at compile time, so the protocol code compiles to direct
+ * calls on each target and no virtual dispatch sits on the packet path.
+ *
+ * A policy provides:
+ *
+ *   class Tls    bool connect(host, port); int read(buf, cap, timeout_ms)
+ *                (bytes, 0 on timeout, < 0 on error); bool write(data, len);
+ *                void stop()
+ *   class Udp    bool begin(port); bool send_to(host, port, data, len);
+ *                int next_datagram() (size of the next datagram, 0 if none;
+ *                empty datagrams are dropped, not reported);
+ *                uint32_t sender() (its source IPv4 address, host byte
+ *                order); void read(buf, len) (consumes it)
+ *                Kernel timestamps, where the platform has them (Linux);
+ *                elsewhere these return false: bool enable_timestamps();
+ *                uint32_t last_send_id(); bool send_times(id, software_ns*,
+ *                hardware_ns*); bool receive_times(software_ns*,
+ *                hardware_ns*) for the last read(). Software times are on
+ *                the micros() clock, hardware times on the NIC's clock
+ *                (0 if it has none).
+ *   static bool probe(host, port, timeout_ms)   plain TCP connect
+ *   static uint32_t millis(); static uint32_t micros(); static void delay(ms)
+ *   static void random_bytes(out, len)
+ *   static void aes128_cbc(encrypt, key, iv, data, len)   in place
+ *   static uint32_t free_heap()
+ *
+ * SomfyPoeDefaultPlatform picks the set for the current build: ESP-IDF,
+ * Linux (ESPHome's host platform or the standalone build in
+ * implementations/linux), or ESP32 Arduino otherwise.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(USE_ESP_IDF)
+#include <arpa/inet.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <esp_tls.h>
+#include <fcntl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mbedtls/aes.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#elif defined(USE_HOST) || defined(SOMFY_POE_LINUX)
+#include "somfy_poe_platform_linux.h"
+#else
+#include <WiFiClientSecure.h>
+#include <WiFiUdp.h>
+#include <esp_random.h>
+#include "mbedtls/aes.h"
+#endif
+
+namespace esphome {
+namespace somfy_poe {
+
+#if defined(USE_ESP_IDF) || !(defined(USE_HOST) || defined(SOMFY_POE_LINUX))
+
+// AES-128-CBC through mbedTLS, shared by both ESP32 frameworks
+inline void somfy_poe_mbedtls_aes128_cbc(bool encrypt, const uint8_t* key, uint8_t* iv,
+                                         uint8_t* data, size_t len) {
+  mbedtls_aes_context aes;
+  mbedtls_aes_init(&aes);
+  if (encrypt) {
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+  } else {
+    mbedtls_aes_setkey_dec(&aes, key, 128);
+  }
+  mbedtls_aes_crypt_cbc(&aes, encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, len, iv, data,
+                        data);
+  mbedtls_aes_free(&aes);
+}
+
+#endif
+
+#if defined(USE_ESP_IDF)
+
+// ESP-IDF: esp-tls for the handshake and lwIP sockets for UDP. Motors use
+// self-signed certificates, so the build needs CONFIG_ESP_TLS_INSECURE and
+// CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY.
+struct SomfyPoeIdfPlatform {
+  class Tls {
+   public:
+    ~Tls() {
+      stop();
+    }
+
+    bool connect(const char* host, uint16_t port) {
+      stop();
+      esp_tls_cfg_t cfg = {};
+      cfg.timeout_ms = 5000;
+      cfg.skip_common_name = true;
+      tls_ = esp_tls_init();
+      if (tls_ == nullptr) return false;
+      if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls_) != 1) {
+        stop();
+        return false;
+      }
+      return true;
+    }
+
+    int read(uint8_t* buffer, size_t capacity, uint32_t timeout_ms) {
+      if (tls_ == nullptr) return -1;
+      if (esp_tls_get_bytes_avail(tls_) <= 0) {
+        int fd = -1;
+        if (esp_tls_get_conn_sockfd(tls_, &fd) != ESP_OK) return -1;
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        struct timeval tv = {(time_t) (timeout_ms / 1000), (suseconds_t) ((timeout_ms % 1000) * 1000)};
+        int ready = select(fd + 1, &readable, nullptr, nullptr, &tv);
+        if (ready <= 0) return ready;
+      }
+      int n = esp_tls_conn_read(tls_, buffer, capacity);
+      return n == ESP_TLS_ERR_SSL_WANT_READ ? 0 : n;
+    }
+
+    bool write(const char* data, size_t len) {
+      while (tls_ != nullptr && len > 0) {
+        int n = esp_tls_conn_write(tls_, data, len);
+        if (n == ESP_TLS_ERR_SSL_WANT_WRITE) continue;
+        if (n < 0) return false;
+        data += n;
+        len -= n;
+      }
+      return tls_ != nullptr;
+    }
+
+    void stop() {
+      if (tls_ != nullptr) {
+        esp_tls_conn_destroy(tls_);
+        tls_ = nullptr;
+      }
+    }
+
+   private:
+    esp_tls_t* tls_ = nullptr;
+  };
+
+  // lwIP does not report a datagram's size before reading it, so the
+  // datagram is received into a buffer here and copied out by read()
+  class Udp {
+   public:
+    ~Udp() {
+      if (fd_ >= 0) close(fd_);
+    }
+
+    bool begin(uint16_t port) {
+      if (fd_ >= 0) return true;
+      fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+      if (fd_ < 0) return false;
+      int enable = 1;
+      setsockopt(fd_, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+      fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      return bind(fd_, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+    }
+
+    bool send_to(const char* host, uint16_t port, const uint8_t* data, size_t len) {
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+      return sendto(fd_, data, len, 0, (struct sockaddr*) &addr, sizeof(addr)) == (ssize_t) len;
+    }
+
+    // Skips empty datagrams, so 0 means nothing is waiting
+    int next_datagram() {
+      for (;;) {
+        struct sockaddr_in addr = {};
+        socklen_t addr_len = sizeof(addr);
+        ssize_t n = recvfrom(fd_, buffer_, sizeof(buffer_), MSG_DONTWAIT, (struct sockaddr*) &addr, &addr_len);
+        if (n == 0) continue;
+        length_ = n > 0 ? n : 0;
+        sender_ = ntohl(addr.sin_addr.s_addr);
+        return length_;
+      }
+    }
+
+    uint32_t sender() const {
+      return sender_;
+    }
+
+    void read(uint8_t* out, size_t len) {
+      memcpy(out, buffer_, len < length_ ? len : length_);
+      length_ = 0;
+    }
+
+    bool enable_timestamps() {
+      return false;
+    }
+
+    uint32_t last_send_id() const {
+      return 0;
+    }
+
+    bool send_times(uint32_t id, uint64_t* software_ns, uint64_t* hardware_ns) {
+      return false;
+    }
+
+    bool receive_times(uint64_t* software_ns, uint64_t* hardware_ns) {
+      return false;
+    }
+
+   private:
+    int fd_ = -1;
+    uint8_t buffer_[1536];
+    size_t length_ = 0;
+    uint32_t sender_ = 0;
+  };
+
+  static bool probe(const char* host, uint16_t port, uint32_t timeout_ms) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    connect(fd, (struct sockaddr*) &addr, sizeof(addr));
+
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval tv = {(time_t) (timeout_ms / 1000), (suseconds_t) ((timeout_ms % 1000) * 1000)};
+    int error = -1;
+    socklen_t error_len = sizeof(error);
+    if (select(fd + 1, nullptr, &writable, nullptr, &tv) == 1) {
+      getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    }
+    close(fd);
+    return error == 0;
+  }
+
+  static uint32_t millis() {
+    return (uint32_t) (esp_timer_get_time() / 1000);
+  }
+
+  static uint32_t micros() {
+    return (uint32_t) esp_timer_get_time();
+  }
+
+  static void delay(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+  }
+
+  static void random_bytes(uint8_t* out, size_t len) {
+    esp_fill_random(out, len);
+  }
+
+  static void aes128_cbc(bool encrypt, const uint8_t* key, uint8_t* iv, uint8_t* data, size_t len) {
+    somfy_poe_mbedtls_aes128_cbc(encrypt, key, iv, data, len);
+  }
+
+  static uint32_t free_heap() {
+    return heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  }
+};
+
+using SomfyPoeDefaultPlatform = SomfyPoeIdfPlatform;
+
+#elif defined(USE_HOST) || defined(SOMFY_POE_LINUX)
+
+using SomfyPoeDefaultPlatform = SomfyPoeLinuxPlatform;
+
+#else
+
+// ESP32 Arduino: WiFiClientSecure for the handshake, WiFiUDP for commands
+struct SomfyPoeArduinoPlatform {
+  class Tls {
+   public:
+    bool connect(const char* host, uint16_t port) {
+      client_.setInsecure();  // Motors use self-signed certificates
+      return client_.connect(host, port);
+    }
+
+    int read(uint8_t* buffer, size_t capacity, uint32_t timeout_ms) {
+      uint32_t start = ::millis();
+      while (!client_.available()) {
+        if (!client_.connected()) return -1;
+        if (::millis() - start > timeout_ms) return 0;
+        ::delay(10);
+      }
+      return client_.read(buffer, capacity);
+    }
+
+    bool write(const char* data, size_t len) {
+      return client_.write((const uint8_t*) data, len) == len;
+    }
+
+    void stop() {
+      client_.stop();
+    }
+
+   private:
+    WiFiClientSecure client_;
+  };
+
+  class Udp {
+   public:
+    bool begin(uint16_t port) {
+      return udp_.begin(port);
+    }
+
+    bool send_to(const char* host, uint16_t port, const uint8_t* data, size_t len) {
+      udp_.beginPacket(host, port);
+      udp_.write(data, len);
+      return udp_.endPacket();
+    }
+
+    int next_datagram() {
+      return udp_.parsePacket();
+    }
+
+    uint32_t sender() {
+      IPAddress ip = udp_.remoteIP();
+      return ((uint32_t) ip[0] << 24) | ((uint32_t) ip[1] << 16) | ((uint32_t) ip[2] << 8) | ip[3];
+    }
+
+    void read(uint8_t* out, size_t len) {
+      udp_.read(out, len);
+    }
+
+    bool enable_timestamps() {
+      return false;
+    }
+
+    uint32_t last_send_id() const {
+      return 0;
+    }
+
+    bool send_times(uint32_t id, uint64_t* software_ns, uint64_t* hardware_ns) {
+      return false;
+    }
+
+    bool receive_times(uint64_t* software_ns, uint64_t* hardware_ns) {
+      return false;
+    }
+
+   private:
+    WiFiUDP udp_;
+  };
+
+  static bool probe(const char* host, uint16_t port, uint32_t timeout_ms) {
+    WiFiClient client;
+    bool reachable = client.connect(host, port, timeout_ms);
+    client.stop();
+    return reachable;
+  }
+
+  static uint32_t millis() {
+    return ::millis();
+  }
+
+  static uint32_t micros() {
+    return ::micros();
+  }
+
+  static void delay(uint32_t ms) {
+    ::delay(ms);
+  }
+
+  static void random_bytes(uint8_t* out, size_t len) {
+    esp_fill_random(out, len);
+  }
+
+  static void aes128_cbc(bool encrypt, const uint8_t* key, uint8_t* iv, uint8_t* data, size_t len) {
+    somfy_poe_mbedtls_aes128_cbc(encrypt, key, iv, data, len);
+  }
+
+  static uint32_t free_heap() {
+    return ESP.getFreeHeap();
+  }
+};
+
+using SomfyPoeDefaultPlatform = SomfyPoeArduinoPlatform;
+
+#endif
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,416 @@
+/*
+ * Linux platform policy for the Somfy PoE protocol implementation
+ *
+ * Used by ESPHome's host platform and by the standalone host build in
+ * implementations/linux. TLS and AES come from OpenSSL (link libssl and
+ * libcrypto), sockets and clocks from POSIX.
+ *
+ * See somfy_poe_platform.h for the policy interface.
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+
+namespace esphome {
+namespace somfy_poe {
+
+struct SomfyPoeLinuxPlatform {
+  class Tls {
+   public:
+    ~Tls() {
+      stop();
+    }
+
+    bool connect(const char* host, uint16_t port) {
+      stop();
+      fd_ = connect_tcp(host, port, 5000);
+      if (fd_ < 0) return false;
+
+      // Motors use self-signed certificates
+      static SSL_CTX* context = [] {
+        SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        return ctx;
+      }();
+      ssl_ = SSL_new(context);
+      SSL_set_fd(ssl_, fd_);
+      if (SSL_connect(ssl_) != 1) {
+        ERR_clear_error();
+        stop();
+        return false;
+      }
+      return true;
+    }
+
+    int read(uint8_t* buffer, size_t capacity, uint32_t timeout_ms) {
+      if (ssl_ == nullptr) return -1;
+      if (SSL_pending(ssl_) == 0) {
+        struct pollfd readable = {fd_, POLLIN, 0};
+        int ready = poll(&readable, 1, timeout_ms);
+        if (ready <= 0) return ready;
+      }
+      int n = SSL_read(ssl_, buffer, capacity);
+      if (n > 0) return n;
+      int error = SSL_get_error(ssl_, n);
+      return error == SSL_ERROR_WANT_READ ? 0 : -1;
+    }
+
+    bool write(const char* data, size_t len) {
+      return ssl_ != nullptr && SSL_write(ssl_, data, len) == (int) len;
+    }
+
+    void stop() {
+      if (ssl_ != nullptr) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+      }
+      if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+      }
+    }
+
+   private:
+    int fd_ = -1;
+    SSL* ssl_ = nullptr;
+  };
+
+  class Udp {
+   public:
+    ~Udp() {
+      if (fd_ >= 0) close(fd_);
+    }
+
+    bool begin(uint16_t port) {
+      if (fd_ >= 0) return true;
+      fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd_ < 0) return false;
+      int enable = 1;
+      setsockopt(fd_, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+      // Lets a simulated motor on a loopback address share the port. Not
+      // SO_REUSEPORT: the kernel would spread replies across every socket
+      // on the port, so motors share one socket instead (SomfyPoeUdpSocket).
+      setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+      enable_busy_poll(fd_);
+
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      return bind(fd_, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+    }
+
+    bool send_to(const char* host, uint16_t port, const uint8_t* data, size_t len) {
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+      if (sendto(fd_, data, len, 0, (struct sockaddr*) &addr, sizeof(addr)) != (ssize_t) len) return false;
+      if (timestamps_) sends_++;
+      return true;
+    }
+
+    // MSG_TRUNC reports the datagram's full size without consuming it. An
+    // empty datagram would be peeked forever, so it is read and dropped.
+    int next_datagram() {
+      if (timestamps_) drain_send_times();
+      uint8_t probe;
+      for (;;) {
+        struct sockaddr_in addr = {};
+        socklen_t addr_len = sizeof(addr);
+        ssize_t n = recvfrom(fd_, &probe, 1, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT, (struct sockaddr*) &addr, &addr_len);
+        if (n < 0) return 0;
+        if (n == 0) {
+          recv(fd_, &probe, 1, MSG_DONTWAIT);
+          continue;
+        }
+        sender_ = ntohl(addr.sin_addr.s_addr);
+        return (int) n;
+      }
+    }
+
+    uint32_t sender() const {
+      return sender_;
+    }
+
+    void read(uint8_t* out, size_t len) {
+      if (!timestamps_) {
+        recv(fd_, out, len, MSG_DONTWAIT);
+        return;
+      }
+
+      struct iovec iov = {out, len};
+      char control[256];
+      struct msghdr msg = {};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      receive_software_ns_ = 0;
+      receive_hardware_ns_ = 0;
+      if (recvmsg(fd_, &msg, MSG_DONTWAIT) < 0) return;
+      for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+          read_times(c, &receive_software_ns_, &receive_hardware_ns_);
+        }
+      }
+    }
+
+    // SO_TIMESTAMPING: software times always, hardware times where the NIC
+    // stamps packets (see enable_hardware_timestamps()). Transmit times
+    // come back on the error queue, numbered by datagrams sent.
+    bool enable_timestamps() {
+      int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                  SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+                  SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+      timestamps_ = fd_ >= 0 && setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+      sends_ = 0;
+      return timestamps_;
+    }
+
+    uint32_t last_send_id() const {
+      return sends_ - 1;
+    }
+
+    bool send_times(uint32_t id, uint64_t* software_ns, uint64_t* hardware_ns) {
+      if (!timestamps_) return false;
+      drain_send_times();
+      const SendTimes& slot = send_times_[id % SEND_TIMES];
+      if (slot.id != id) return false;
+      *software_ns = slot.software_ns;
+      *hardware_ns = slot.hardware_ns;
+      return true;
+    }
+
+    bool receive_times(uint64_t* software_ns, uint64_t* hardware_ns) {
+      *software_ns = receive_software_ns_;
+      *hardware_ns = receive_hardware_ns_;
+      return timestamps_ && receive_software_ns_ != 0;
+    }
+
+    // Linux only: consumes the next datagram and reports its sender, for
+    // one socket shared by several motors. Returns 0 if none is waiting.
+    int receive_from(uint8_t* out, size_t capacity, char* host, size_t host_capacity) {
+      struct sockaddr_in addr = {};
+      socklen_t addr_len = sizeof(addr);
+      ssize_t n = recvfrom(fd_, out, capacity, MSG_DONTWAIT, (struct sockaddr*) &addr, &addr_len);
+      if (n <= 0) return 0;
+      inet_ntop(AF_INET, &addr.sin_addr, host, host_capacity);
+      return (int) n;
+    }
+
+    int fd() const {
+      return fd_;
+    }
+
+   private:
+    struct SendTimes {
+      uint32_t id = UINT32_MAX;
+      uint64_t software_ns = 0;
+      uint64_t hardware_ns = 0;
+    };
+    static const size_t SEND_TIMES = 256;  // Sends by every motor sharing the socket
+
+    int fd_ = -1;
+    uint32_t sender_ = 0;
+    bool timestamps_ = false;
+    uint32_t sends_ = 0;
+    SendTimes send_times_[SEND_TIMES];
+    uint64_t receive_software_ns_ = 0;
+    uint64_t receive_hardware_ns_ = 0;
+
+    // Also keeps the error queue from filling the receive buffer. Software
+    // and hardware times of one datagram arrive as separate messages.
+    void drain_send_times() {
+      char control[256];
+      while (true) {
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+        uint64_t software_ns = 0;
+        uint64_t hardware_ns = 0;
+        bool numbered = false;
+        uint32_t id = 0;
+        for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c)) {
+          if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+            read_times(c, &software_ns, &hardware_ns);
+          } else if (c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) {
+            struct sock_extended_err error;
+            memcpy(&error, CMSG_DATA(c), sizeof(error));
+            if (error.ee_errno == ENOMSG && error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+              id = error.ee_data;
+              numbered = true;
+            }
+          }
+        }
+        if (!numbered) continue;
+
+        SendTimes& slot = send_times_[id % SEND_TIMES];
+        if (slot.id != id) slot = SendTimes{id, 0, 0};
+        if (software_ns != 0) slot.software_ns = software_ns;
+        if (hardware_ns != 0) slot.hardware_ns = hardware_ns;
+      }
+    }
+
+    // Software times are CLOCK_REALTIME; moved to the micros() clock here
+    static void read_times(struct cmsghdr* c, uint64_t* software_ns, uint64_t* hardware_ns) {
+      struct scm_timestamping times;
+      memcpy(&times, CMSG_DATA(c), sizeof(times));
+      if (times.ts[0].tv_sec != 0 || times.ts[0].tv_nsec != 0) {
+        struct timespec realtime, monotonic;
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        int64_t offset = to_ns(realtime) - to_ns(monotonic);
+        *software_ns = to_ns(times.ts[0]) - offset;
+      }
+      if (times.ts[2].tv_sec != 0 || times.ts[2].tv_nsec != 0) *hardware_ns = to_ns(times.ts[2]);
+    }
+
+    static int64_t to_ns(const struct timespec& ts) {
+      return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+  };
+
+  // Linux only: makes the NIC timestamp all packets on `interface`
+  // (SIOCSHWTSTAMP, needs CAP_NET_ADMIN), so Udp::enable_timestamps() also
+  // reports hardware times where the driver supports them
+  static bool enable_hardware_timestamps(const char* interface) {
+    struct hwtstamp_config config = {};
+    config.tx_type = HWTSTAMP_TX_ON;
+    config.rx_filter = HWTSTAMP_FILTER_ALL;
+    struct ifreq request = {};
+    strncpy(request.ifr_name, interface, sizeof(request.ifr_name) - 1);
+    request.ifr_data = (char*) &config;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    bool enabled = fd >= 0 && ioctl(fd, SIOCSHWTSTAMP, &request) == 0;
+    if (fd >= 0) close(fd);
+    return enabled;
+  }
+
+  // Linux only: SO_BUSY_POLL (and SO_PREFER_BUSY_POLL) for UDP sockets
+  // opened afterwards, so reads poll the NIC's queue instead of waiting for
+  // its interrupt; 0 turns it off. Values above net.core.busy_read need
+  // CAP_NET_ADMIN; returns false if the kernel refuses.
+  static bool set_busy_poll(uint32_t us) {
+    busy_poll_us() = 0;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    int value = us;
+    bool allowed = setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) == 0;
+    close(fd);
+    if (allowed) busy_poll_us() = us;
+    return allowed;
+  }
+
+  static bool probe(const char* host, uint16_t port, uint32_t timeout_ms) {
+    int fd = connect_tcp(host, port, timeout_ms);
+    if (fd < 0) return false;
+    close(fd);
+    return true;
+  }
+
+  static uint32_t millis() {
+    return (uint32_t) (monotonic_us() / 1000);
+  }
+
+  static uint32_t micros() {
+    return (uint32_t) monotonic_us();
+  }
+
+  static void delay(uint32_t ms) {
+    struct timespec ts = {(time_t) (ms / 1000), (long) (ms % 1000) * 1000000};
+    nanosleep(&ts, nullptr);
+  }
+
+  static void random_bytes(uint8_t* out, size_t len) {
+    RAND_bytes(out, len);
+  }
+
+  // Padding is handled by the protocol code, so OpenSSL's is disabled
+  static void aes128_cbc(bool encrypt, const uint8_t* key, uint8_t* iv, uint8_t* data, size_t len) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_CipherInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key, iv, encrypt ? 1 : 0);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    int out_len = 0;
+    EVP_CipherUpdate(ctx, data, &out_len, data, len);
+    EVP_CIPHER_CTX_free(ctx);
+  }
+
+  // No heap floor on a host
+  static uint32_t free_heap() {
+    return UINT32_MAX;
+  }
+
+ private:
+  static uint32_t& busy_poll_us() {
+    static uint32_t us = 0;
+    return us;
+  }
+
+  static void enable_busy_poll(int fd) {
+    int value = busy_poll_us();
+    if (value == 0) return;
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+#ifdef SO_PREFER_BUSY_POLL
+    int prefer = 1;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+#endif
+  }
+
+  static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  // Blocking connect with a timeout; returns the socket or -1
+  static int connect_tcp(const char* host, uint16_t port, uint32_t timeout_ms) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+      struct pollfd writable = {fd, POLLOUT, 0};
+      int error = -1;
+      socklen_t error_len = sizeof(error);
+      if (poll(&writable, 1, timeout_ms) == 1) {
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+      }
+      if (error != 0) {
+        close(fd);
+        return -1;
+      }
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    return fd;
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,246 @@
+/*
+ * Runtime motor registry for Somfy PoE
+ *
+ * Motors listed in the YAML are compiled into the firmware. The registry
+ * keeps an additional list of motors in flash that can be edited at
+ * runtime through Home Assistant services, so a blind can be added or
+ * removed without recompiling or rebooting the controller.
+ *
+ * Registered motors are created at boot (and immediately when added),
+ * handed to the hub, and driven from the registry's own loop.
+ *
+ * Requires somfy_poe_hub.h.
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef SOMFY_POE_REGISTRY_MAX_MOTORS
+#define SOMFY_POE_REGISTRY_MAX_MOTORS 16
+#endif
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeRegistry : public Component, public api::CustomAPIDevice {
+ public:
+  explicit SomfyPoeRegistry(SomfyPoeHub* hub) : hub_(hub) {
+    memset(&stored_, 0, sizeof(stored_));
+  }
+
+  // After the hub, so runtime motors join its session cap
+  float get_setup_priority() const override {
+    return setup_priority::LATE - 1.0f;
+  }
+
+  void setup() override {
+    preference_ = global_preferences->make_preference<StoredRegistry>(PREFERENCE_HASH);
+    if (!preference_.load(&stored_) || stored_.version != STORED_VERSION) {
+      memset(&stored_, 0, sizeof(stored_));
+      stored_.version = STORED_VERSION;
+    }
+
+    for (size_t i = 0; i < SOMFY_POE_REGISTRY_MAX_MOTORS; i++) {
+      if (stored_.entries[i].used) start_motor(i);
+    }
+
+    register_service(&SomfyPoeRegistry::on_add_motor, "somfy_add_motor", {"ip", "pin", "name"});
+    register_service(&SomfyPoeRegistry::on_remove_motor, "somfy_remove_motor", {"ip"});
+  }
+
+  void loop() override {
+    for (auto& running : running_) {
+      if (running != nullptr) running->motor->loop();
+    }
+
+    // A removed motor is deleted once no handshake can call back into it
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [](const std::unique_ptr<Running>& running) {
+                                    return !running->motor->is_handshaking();
+                                  }),
+                   retired_.end());
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE Registry: %u/%u motor(s)", (unsigned) size(),
+                  (unsigned) SOMFY_POE_REGISTRY_MAX_MOTORS);
+    for (const auto& entry : stored_.entries) {
+      if (entry.used) ESP_LOGCONFIG("somfy_poe", "  %s (%s)", entry.name, entry.ip);
+    }
+  }
+
+  // Adds a motor (or updates the PIN and name of a registered one), starts
+  // it and persists the registry. Returns false if the registry is full, an
+  // argument does not fit, or the hub already has a motor at that address
+  // (e.g. one from the YAML).
+  bool add_motor(const std::string& ip, const std::string& pin, const std::string& name) {
+    if (ip.empty() || ip.size() >= sizeof(Entry::ip) || pin.size() >= sizeof(Entry::pin) ||
+        name.size() >= sizeof(Entry::name)) {
+      ESP_LOGW("somfy_poe", "Registry: invalid motor '%s'", ip.c_str());
+      return false;
+    }
+
+    int index = find(ip);
+    if (index < 0 && is_on_hub(ip.c_str())) {
+      ESP_LOGW("somfy_poe", "Registry: %s is already a motor of the hub", ip.c_str());
+      return false;
+    }
+    if (index >= 0) {
+      stop_motor(index);
+    } else {
+      index = find_free();
+      if (index < 0) {
+        ESP_LOGW("somfy_poe", "Registry full, cannot add %s", ip.c_str());
+        return false;
+      }
+    }
+
+    Entry& entry = stored_.entries[index];
+    entry.used = true;
+    strncpy(entry.ip, ip.c_str(), sizeof(entry.ip));
+    strncpy(entry.pin, pin.c_str(), sizeof(entry.pin));
+    strncpy(entry.name, name.empty() ? ip.c_str() : name.c_str(), sizeof(entry.name));
+    save();
+
+    start_motor(index);
+    ESP_LOGI("somfy_poe", "Registry: added %s (%s)", entry.name, entry.ip);
+    return true;
+  }
+
+  bool remove_motor(const std::string& ip) {
+    int index = find(ip);
+    if (index < 0) return false;
+
+    stop_motor(index);
+    memset(&stored_.entries[index], 0, sizeof(Entry));
+    save();
+
+    ESP_LOGI("somfy_poe", "Registry: removed %s", ip.c_str());
+    return true;
+  }
+
+  // The running motor for an address, or nullptr
+  SomfyPoeMotor* get_motor(const std::string& ip) const {
+    int index = find(ip);
+    return index >= 0 && running_[index] != nullptr ? running_[index]->motor.get() : nullptr;
+  }
+
+  const char* get_motor_name(const SomfyPoeMotor* motor) const {
+    for (size_t i = 0; i < SOMFY_POE_REGISTRY_MAX_MOTORS; i++) {
+      if (running_[i] != nullptr && running_[i]->motor.get() == motor) return stored_.entries[i].name;
+    }
+    return nullptr;
+  }
+
+  size_t size() const {
+    size_t count = 0;
+    for (const auto& entry : stored_.entries) {
+      if (entry.used) count++;
+    }
+    return count;
+  }
+
+ private:
+  // Bump when Entry changes so stale flash contents are discarded
+  static const uint32_t STORED_VERSION = 1;
+  static const uint32_t PREFERENCE_HASH = 0x50E7F001;
+
+  struct Entry {
+    bool used;
+    char ip[16];
+    char pin[8];
+    char name[32];
+  };
+
+  struct StoredRegistry {
+    uint32_t version;
+    Entry entries[SOMFY_POE_REGISTRY_MAX_MOTORS];
+  };
+
+  // A started motor and its own copy of the address and PIN it points to,
+  // so the entry can be reused while a removed motor finishes a handshake
+  struct Running {
+    char ip[sizeof(Entry::ip)];
+    char pin[sizeof(Entry::pin)];
+    std::unique_ptr<SomfyPoeMotor> motor;
+  };
+
+  SomfyPoeHub* hub_;
+  ESPPreferenceObject preference_;
+  StoredRegistry stored_;
+  std::unique_ptr<Running> running_[SOMFY_POE_REGISTRY_MAX_MOTORS];
+  std::vector<std::unique_ptr<Running>> retired_;  // Removed, still handshaking
+
+  void on_add_motor(std::string ip, std::string pin, std::string name) {
+    add_motor(ip, pin, name);
+  }
+
+  void on_remove_motor(std::string ip) {
+    remove_motor(ip);
+  }
+
+  int find(const std::string& ip) const {
+    for (size_t i = 0; i < SOMFY_POE_REGISTRY_MAX_MOTORS; i++) {
+      if (stored_.entries[i].used && ip == stored_.entries[i].ip) return i;
+    }
+    return -1;
+  }
+
+  int find_free() const {
+    for (size_t i = 0; i < SOMFY_POE_REGISTRY_MAX_MOTORS; i++) {
+      if (!stored_.entries[i].used) return i;
+    }
+    return -1;
+  }
+
+  bool is_on_hub(const char* ip) const {
+    for (SomfyPoeMotor* motor : hub_->get_motors()) {
+      if (strcmp(motor->get_motor_ip(), ip) == 0) return true;
+    }
+    return false;
+  }
+
+  // A stored motor whose address the hub already has (e.g. added to the
+  // YAML since) is skipped, so it cannot take over that motor's replies
+  void start_motor(size_t index) {
+    const Entry& entry = stored_.entries[index];
+    if (is_on_hub(entry.ip)) {
+      ESP_LOGW("somfy_poe", "Registry: %s is already a motor of the hub, not starting it", entry.ip);
+      return;
+    }
+
+    std::unique_ptr<Running> running(new Running());
+    memcpy(running->ip, entry.ip, sizeof(running->ip));
+    memcpy(running->pin, entry.pin, sizeof(running->pin));
+    running->motor.reset(new SomfyPoeMotor(running->ip, running->pin));
+    hub_->add_motor(running->motor.get());
+    running->motor->setup();
+    running_[index] = std::move(running);
+  }
+
+  // The executor of a handshake in flight still holds the motor (see
+  // SomfyPoeMotor::set_handshake_executor()), so then it is retired and
+  // deleted by loop() once the handshake is done
+  void stop_motor(size_t index) {
+    std::unique_ptr<Running> running = std::move(running_[index]);
+    if (running == nullptr) return;
+
+    hub_->remove_motor(running->motor.get());
+    running->motor->close_session();
+    if (running->motor->is_handshaking()) retired_.push_back(std::move(running));
+  }
+
+  void save() {
+    preference_.save(&stored_);
+    global_preferences->sync();
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
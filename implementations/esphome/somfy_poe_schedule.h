@@ -0,0 +1,228 @@
+/*
+ * On-device schedule for Somfy PoE motors
+ *
+ * Runs daily timed moves on the controller itself, so schedules keep
+ * working while Home Assistant is unavailable. Each entry fires at a local
+ * time of day on selected weekdays (plus an optional offset) and moves one
+ * or more motors, through the hub when one is given.
+ *
+ * Upcoming fire times are kept in a min-heap, so loop() only compares the
+ * earliest one against the clock. Fire times are tracked in milliseconds by
+ * anchoring millis() to the moment the clock's second changes.
+ *
+ * Requires somfy_poe_hub.h and an ESPHome time component (e.g. sntp).
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+#include <algorithm>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeSchedule : public Component {
+ public:
+  // Day masks, bit (day_of_week - 1) with ESPHome's 1 = Sunday
+  static const uint8_t EVERY_DAY = 0x7F;
+  static const uint8_t WEEKDAYS = 0x3E;
+  static const uint8_t WEEKENDS = 0x41;
+
+  explicit SomfyPoeSchedule(time::RealTimeClock* clock, SomfyPoeHub* hub = nullptr)
+    : clock_(clock),
+      hub_(hub),
+      last_epoch_(0),
+      tick_ms_(0),
+      last_dst_(false),
+      fired_(0) {
+    if (hub_ != nullptr) {
+      hub_->add_on_motor_removed_callback([this](SomfyPoeMotor* motor) { this->remove_motor(motor); });
+    }
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE Schedule: %u entr%s", (unsigned) entries_.size(),
+                  entries_.size() == 1 ? "y" : "ies");
+    for (size_t id = 0; id < entries_.size(); id++) {
+      const Entry& entry = entries_[id];
+      ESP_LOGCONFIG("somfy_poe", "  #%u %02u:%02u:%02u%+ds days 0x%02X, %u motor(s)%s",
+                    (unsigned) id, entry.hour, entry.minute, entry.second, (int) entry.offset_s,
+                    entry.days, (unsigned) entry.targets.size(), entry.enabled ? "" : " (disabled)");
+    }
+  }
+
+  // Adds a daily entry and returns its id. offset_s shifts the fire time,
+  // e.g. to stagger entries sharing a time of day.
+  size_t add_entry(uint8_t hour, uint8_t minute, uint8_t second,
+                   const std::vector<SomfyPoeSceneTarget>& targets, uint8_t days = EVERY_DAY,
+                   int32_t offset_s = 0) {
+    Entry entry;
+    entry.hour = hour;
+    entry.minute = minute;
+    entry.second = second;
+    entry.days = days & EVERY_DAY;
+    entry.offset_s = offset_s;
+    entry.targets = targets;
+    entries_.push_back(entry);
+
+    size_t id = entries_.size() - 1;
+    if (last_epoch_ != 0) schedule(id);
+    return id;
+  }
+
+  // Drops a motor from every entry. Motors removed from the hub are dropped
+  // automatically; without a hub, call this before deleting a motor.
+  void remove_motor(SomfyPoeMotor* motor) {
+    for (Entry& entry : entries_) {
+      entry.targets.erase(std::remove_if(entry.targets.begin(), entry.targets.end(),
+                                         [motor](const SomfyPoeSceneTarget& target) { return target.motor == motor; }),
+                          entry.targets.end());
+    }
+  }
+
+  void set_enabled(size_t id, bool enabled) {
+    if (id >= entries_.size() || entries_[id].enabled == enabled) return;
+    entries_[id].enabled = enabled;
+    entries_[id].generation++;  // Invalidates the entry's queued fire time
+    if (enabled && last_epoch_ != 0) schedule(id);
+  }
+
+  // Milliseconds until the next enabled entry fires, or -1
+  int64_t get_next_fire_in_ms() const {
+    if (queue_.empty() || last_epoch_ == 0) return -1;
+    return std::max<int64_t>(0, queue_.front().fire_ms - now_ms());
+  }
+
+  uint32_t get_fired_count() const {
+    return fired_;
+  }
+
+  void loop() override {
+    if (!update_clock()) return;
+
+    int64_t now = now_ms();
+    while (!queue_.empty() && queue_.front().fire_ms <= now) {
+      std::pop_heap(queue_.begin(), queue_.end(), Later());
+      QueuedFire fire = queue_.back();
+      queue_.pop_back();
+
+      Entry& entry = entries_[fire.id];
+      if (fire.generation != entry.generation || !entry.enabled) continue;
+
+      run(entry, now - fire.fire_ms);
+      schedule(fire.id);
+    }
+  }
+
+ private:
+  struct Entry {
+    uint8_t hour = 0;
+    uint8_t minute = 0;
+    uint8_t second = 0;
+    uint8_t days = EVERY_DAY;
+    int32_t offset_s = 0;
+    bool enabled = true;
+    uint32_t generation = 0;
+    std::vector<SomfyPoeSceneTarget> targets;
+  };
+
+  struct QueuedFire {
+    int64_t fire_ms;  // Unix time in ms
+    size_t id;
+    uint32_t generation;
+  };
+
+  struct Later {
+    bool operator()(const QueuedFire& a, const QueuedFire& b) const {
+      return a.fire_ms > b.fire_ms;
+    }
+  };
+
+  // Clock steps larger than this (SNTP corrections) rebuild the queue, as
+  // does a change of daylight saving time
+  static const int64_t CLOCK_STEP_MS = 2000;
+
+  time::RealTimeClock* clock_;
+  SomfyPoeHub* hub_;
+  std::vector<Entry> entries_;
+  std::vector<QueuedFire> queue_;  // Min-heap on fire_ms
+  time_t last_epoch_;
+  uint32_t tick_ms_;  // millis() when last_epoch_ began
+  bool last_dst_;
+  uint32_t fired_;
+
+  int64_t now_ms() const {
+    return (int64_t) last_epoch_ * 1000 + (millis() - tick_ms_);
+  }
+
+  // Anchors millis() to the clock's second boundaries. Returns false while
+  // the clock has no valid time.
+  bool update_clock() {
+    ESPTime now = clock_->now();
+    if (!now.is_valid()) return false;
+    if (now.timestamp == last_epoch_) return true;
+
+    bool first = last_epoch_ == 0;
+    int64_t expected = first ? 0 : now_ms();
+    last_epoch_ = now.timestamp;
+    tick_ms_ = millis();
+
+    int64_t step = now_ms() - expected;
+    bool dst_changed = now.is_dst != last_dst_;
+    last_dst_ = now.is_dst;
+    if (first || dst_changed || step > CLOCK_STEP_MS || step < -CLOCK_STEP_MS) {
+      if (!first) ESP_LOGD("somfy_poe", "Clock changed by %d ms, rescheduling", (int) step);
+      rebuild();
+    }
+    return true;
+  }
+
+  void rebuild() {
+    queue_.clear();
+    for (size_t id = 0; id < entries_.size(); id++) {
+      entries_[id].generation++;
+      if (entries_[id].enabled) schedule(id);
+    }
+  }
+
+  // Queues the entry's next fire time after now, searching a week ahead
+  void schedule(size_t id) {
+    const Entry& entry = entries_[id];
+    if (entry.days == 0) return;
+
+    ESPTime now = clock_->now();
+    int32_t now_s = now.hour * 3600 + now.minute * 60 + now.second;
+    int32_t entry_s = entry.hour * 3600 + entry.minute * 60 + entry.second + entry.offset_s;
+    int64_t midnight_ms = (int64_t) (now.timestamp - now_s) * 1000;
+
+    for (int day = 0; day <= 7; day++) {
+      int weekday = (now.day_of_week - 1 + day) % 7;
+      if (!(entry.days & (1 << weekday))) continue;
+
+      int64_t fire_ms = midnight_ms + ((int64_t) day * 86400 + entry_s) * 1000;
+      if (fire_ms <= now_ms()) continue;
+
+      queue_.push_back({fire_ms, id, entry.generation});
+      std::push_heap(queue_.begin(), queue_.end(), Later());
+      return;
+    }
+  }
+
+  void run(const Entry& entry, int64_t late_ms) {
+    fired_++;
+    ESP_LOGI("somfy_poe", "Schedule %02u:%02u:%02u firing for %u motor(s), %d ms late",
+             entry.hour, entry.minute, entry.second, (unsigned) entry.targets.size(), (int) late_ms);
+
+    if (hub_ != nullptr) {
+      hub_->apply_scene(entry.targets);
+      return;
+    }
+    for (const auto& target : entry.targets) {
+      target.motor->move_to_position(target.position);
+    }
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,367 @@
+/*
+ * Sun-driven shading for Somfy PoE motors
+ *
+ * Moves blinds per facade when the sun shines on it, either fully to the
+ * shaded position or, with a sun depth set, just far enough to keep direct
+ * sun within that depth of the window. Sun elevation and azimuth for the
+ * installation's location are precomputed at compile time into a table
+ * over the year and the UTC day, so the controller only interpolates them
+ * at runtime. A facade's position comes from the same table plus a table of
+ * cosines, so no trigonometry runs on the controller.
+ *
+ * The location is set with build flags (degrees, north and east positive):
+ *
+ *   -DSOMFY_POE_LATITUDE=51.48 -DSOMFY_POE_LONGITUDE=-0.01
+ *
+ * Requires somfy_poe_hub.h and an ESPHome time component (e.g. sntp).
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if !defined(SOMFY_POE_LATITUDE) || !defined(SOMFY_POE_LONGITUDE)
+#error "somfy_poe_shading.h needs -DSOMFY_POE_LATITUDE=<deg> and -DSOMFY_POE_LONGITUDE=<deg>"
+#endif
+
+namespace esphome {
+namespace somfy_poe {
+
+// Minimal constexpr math for building the solar table at compile time
+namespace solar_math {
+
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double radians(double degrees) {
+  return degrees * PI / 180.0;
+}
+
+constexpr double degrees(double radians) {
+  return radians * 180.0 / PI;
+}
+
+constexpr double sqrt(double x) {
+  if (x <= 0.0) return 0.0;
+  double guess = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 60; i++) guess = 0.5 * (guess + x / guess);
+  return guess;
+}
+
+constexpr double sin(double x) {
+  while (x > PI) x -= 2.0 * PI;
+  while (x < -PI) x += 2.0 * PI;
+  double term = x;
+  double sum = x;
+  for (int n = 1; n < 14; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cos(double x) {
+  return sin(x + PI / 2.0);
+}
+
+constexpr double atan(double x) {
+  if (x < 0.0) return -atan(-x);
+  if (x > 1.0) return PI / 2.0 - atan(1.0 / x);
+  // Halve the argument twice so the series converges quickly
+  double reduced = x / (1.0 + sqrt(1.0 + x * x));
+  reduced = reduced / (1.0 + sqrt(1.0 + reduced * reduced));
+  double term = reduced;
+  double sum = reduced;
+  for (int n = 1; n < 20; n++) {
+    term *= -reduced * reduced;
+    sum += term / (2 * n + 1);
+  }
+  return 4.0 * sum;
+}
+
+constexpr double atan2(double y, double x) {
+  if (x > 0.0) return atan(y / x);
+  if (x < 0.0) return y >= 0.0 ? atan(y / x) + PI : atan(y / x) - PI;
+  return y > 0.0 ? PI / 2.0 : (y < 0.0 ? -PI / 2.0 : 0.0);
+}
+
+constexpr double asin(double x) {
+  return atan2(x, sqrt(1.0 - x * x));
+}
+
+}  // namespace solar_math
+
+// Sun position over the year, sampled every ~15 days and every 15 minutes
+// of the UTC day. Angles are stored in 0.01 degree units; azimuth is
+// measured clockwise from north. The elevation's tangent, for the profile
+// angle, is stored in 0.001 units and capped near the zenith.
+struct SomfyPoeSolarSamples {
+  static const int DAYS = 25;
+  static const int SLOTS = 96;
+  static constexpr double MAX_TAN = 32.0;
+
+  int16_t elevation[DAYS][SLOTS];
+  uint16_t azimuth[DAYS][SLOTS];
+  int16_t tan_elevation[DAYS][SLOTS];
+};
+
+// NOAA's fractional-year approximation, accurate to a fraction of a degree
+constexpr SomfyPoeSolarSamples somfy_poe_build_solar_samples() {
+  using Samples = SomfyPoeSolarSamples;
+  Samples samples{};
+  const double latitude = solar_math::radians(SOMFY_POE_LATITUDE);
+  for (int d = 0; d < Samples::DAYS; d++) {
+    for (int s = 0; s < Samples::SLOTS; s++) {
+      double day_of_year = 1.0 + d * 365.0 / (Samples::DAYS - 1);
+      double minutes = s * (1440.0 / Samples::SLOTS);
+      double gamma = 2.0 * solar_math::PI / 365.0 * (day_of_year - 1.0 + (minutes / 60.0 - 12.0) / 24.0);
+
+      double equation_of_time =
+          229.18 * (0.000075 + 0.001868 * solar_math::cos(gamma) - 0.032077 * solar_math::sin(gamma) -
+                    0.014615 * solar_math::cos(2 * gamma) - 0.040849 * solar_math::sin(2 * gamma));
+      double declination = 0.006918 - 0.399912 * solar_math::cos(gamma) + 0.070257 * solar_math::sin(gamma) -
+                           0.006758 * solar_math::cos(2 * gamma) + 0.000907 * solar_math::sin(2 * gamma) -
+                           0.002697 * solar_math::cos(3 * gamma) + 0.00148 * solar_math::sin(3 * gamma);
+
+      double true_solar_minutes = minutes + equation_of_time + 4.0 * SOMFY_POE_LONGITUDE;
+      double hour_angle = solar_math::radians(true_solar_minutes / 4.0 - 180.0);
+
+      double sin_elevation = solar_math::sin(latitude) * solar_math::sin(declination) +
+                             solar_math::cos(latitude) * solar_math::cos(declination) * solar_math::cos(hour_angle);
+      double elevation = solar_math::degrees(solar_math::asin(sin_elevation));
+
+      // Measured from south, westward positive, then turned to north-based
+      double azimuth = solar_math::degrees(solar_math::atan2(
+          solar_math::sin(hour_angle),
+          solar_math::cos(hour_angle) * solar_math::sin(latitude) -
+              solar_math::sin(declination) / solar_math::cos(declination) * solar_math::cos(latitude)));
+      azimuth += 180.0;
+      if (azimuth >= 360.0) azimuth -= 360.0;
+
+      double tan_elevation = sin_elevation / solar_math::sqrt(1.0 - sin_elevation * sin_elevation);
+      tan_elevation = std::max(-Samples::MAX_TAN, std::min(Samples::MAX_TAN, tan_elevation));
+
+      samples.elevation[d][s] = (int16_t) (elevation * 100.0 + (elevation < 0 ? -0.5 : 0.5));
+      samples.azimuth[d][s] = (uint16_t) (azimuth * 100.0 + 0.5);
+      samples.tan_elevation[d][s] = (int16_t) (tan_elevation * 1000.0 + (tan_elevation < 0 ? -0.5 : 0.5));
+    }
+  }
+  return samples;
+}
+
+class SomfyPoeSolarTable {
+ public:
+  static const int DAYS = SomfyPoeSolarSamples::DAYS;
+  static const int SLOTS = SomfyPoeSolarSamples::SLOTS;
+
+  // Evaluated by the compiler; only the ~14.4 KB result ends up in flash
+  static constexpr SomfyPoeSolarSamples TABLE = somfy_poe_build_solar_samples();
+
+  // Bilinear interpolation for a UTC day of year (1-366) and time of day
+  static void lookup(int day_of_year, uint32_t utc_seconds, float* elevation, float* azimuth,
+                     float* tan_elevation) {
+    float day = (day_of_year - 1) * (DAYS - 1) / 365.0f;
+    if (day > DAYS - 1) day = DAYS - 1;
+    int d0 = (int) day;
+    int d1 = d0 + 1 < DAYS ? d0 + 1 : d0;
+    float fd = day - d0;
+
+    float slot = utc_seconds * SLOTS / 86400.0f;
+    int s0 = (int) slot % SLOTS;
+    int s1 = (s0 + 1) % SLOTS;
+    float fs = slot - (int) slot;
+
+    auto blend = [&](float v00, float v01, float v10, float v11) {
+      return (v00 * (1 - fs) + v01 * fs) * (1 - fd) + (v10 * (1 - fs) + v11 * fs) * fd;
+    };
+
+    *elevation = blend(TABLE.elevation[d0][s0], TABLE.elevation[d0][s1], TABLE.elevation[d1][s0],
+                       TABLE.elevation[d1][s1]) / 100.0f;
+    *tan_elevation = blend(TABLE.tan_elevation[d0][s0], TABLE.tan_elevation[d0][s1],
+                           TABLE.tan_elevation[d1][s0], TABLE.tan_elevation[d1][s1]) / 1000.0f;
+
+    // Unwrap azimuths around the first sample so 359 -> 1 blends through 0
+    float a00 = TABLE.azimuth[d0][s0];
+    auto unwrap = [a00](float a) { return a - a00 > 18000 ? a - 36000 : (a00 - a > 18000 ? a + 36000 : a); };
+    float a = blend(a00, unwrap(TABLE.azimuth[d0][s1]), unwrap(TABLE.azimuth[d1][s0]),
+                    unwrap(TABLE.azimuth[d1][s1])) / 100.0f;
+    *azimuth = a < 0 ? a + 360.0f : (a >= 360.0f ? a - 360.0f : a);
+  }
+};
+
+// Cosine of 0-90 degrees in whole-degree steps, for a facade's azimuth offset
+struct SomfyPoeCosineSamples {
+  float cosine[91];
+};
+
+constexpr SomfyPoeCosineSamples somfy_poe_build_cosine_samples() {
+  SomfyPoeCosineSamples samples{};
+  for (int degree = 0; degree < 90; degree++) {
+    samples.cosine[degree] = (float) solar_math::cos(solar_math::radians(degree));
+  }
+  samples.cosine[90] = 0.0f;  // Exactly, so offsets below 90 never divide by zero or less
+  return samples;
+}
+
+class SomfyPoeCosineTable {
+ public:
+  static constexpr SomfyPoeCosineSamples TABLE = somfy_poe_build_cosine_samples();
+
+  // Linear interpolation for 0-90 degrees
+  static float lookup(float degrees) {
+    if (degrees <= 0.0f) return 1.0f;
+    if (degrees >= 90.0f) return 0.0f;
+    int d0 = (int) degrees;
+    float fd = degrees - d0;
+    return TABLE.cosine[d0] * (1 - fd) + TABLE.cosine[d0 + 1] * fd;
+  }
+};
+
+class SomfyPoeShading : public Component {
+ public:
+  explicit SomfyPoeShading(time::RealTimeClock* clock, SomfyPoeHub* hub = nullptr)
+    : clock_(clock),
+      hub_(hub),
+      threshold_(5.0f),
+      last_update_ms_(0),
+      sun_elevation_(NAN),
+      sun_azimuth_(NAN),
+      sun_tan_elevation_(NAN) {
+    if (hub_ != nullptr) {
+      hub_->add_on_motor_removed_callback([this](SomfyPoeMotor* motor) { this->remove_motor(motor); });
+    }
+  }
+
+  // A facade is in sun while the sun is above min_elevation and less than
+  // 90 degrees from the facade's outward direction (azimuth from north).
+  // Its motors then go to shaded_position, otherwise to open_position.
+  size_t add_facade(float azimuth, const std::vector<SomfyPoeMotor*>& motors,
+                    float shaded_position = 100.0f, float open_position = 0.0f,
+                    float min_elevation = 5.0f) {
+    Facade facade;
+    facade.azimuth = azimuth;
+    facade.motors = motors;
+    facade.shaded_position = shaded_position;
+    facade.open_position = open_position;
+    facade.min_elevation = min_elevation;
+    facades_.push_back(facade);
+    return facades_.size() - 1;
+  }
+
+  // Drops a motor from every facade. Motors removed from the hub are
+  // dropped automatically; without a hub, call this before deleting a motor.
+  void remove_motor(SomfyPoeMotor* motor) {
+    for (Facade& facade : facades_) {
+      facade.motors.erase(std::remove(facade.motors.begin(), facade.motors.end(), motor), facade.motors.end());
+    }
+  }
+
+  // Tracks the sun instead of switching between the two positions. The
+  // blind is lowered until sunlight reaches at most `depth` window heights
+  // into the room: fully shaded for low sun, opening as the sun rises or
+  // moves across the facade. 0 (the default) switches on/off.
+  void set_facade_sun_depth(size_t id, float depth) {
+    if (id >= facades_.size()) return;
+    facades_[id].sun_depth = depth;
+    facades_[id].last_target = NAN;
+  }
+
+  void set_facade_enabled(size_t id, bool enabled) {
+    if (id >= facades_.size()) return;
+    facades_[id].enabled = enabled;
+    facades_[id].last_target = NAN;  // Re-send when re-enabled
+  }
+
+  // Minimum change in target (%) before a facade's motors are moved. On/off
+  // facades only move when their two positions are further apart; it
+  // limits how often facades with a sun depth follow the sun.
+  void set_threshold(float threshold) {
+    threshold_ = threshold;
+  }
+
+  float get_sun_elevation() const {
+    return sun_elevation_;
+  }
+
+  float get_sun_azimuth() const {
+    return sun_azimuth_;
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE Shading at %.3f, %.3f: %u facade(s)",
+                  (float) SOMFY_POE_LATITUDE, (float) SOMFY_POE_LONGITUDE, (unsigned) facades_.size());
+  }
+
+  void loop() override {
+    if (millis() - last_update_ms_ < UPDATE_INTERVAL_MS && last_update_ms_ != 0) return;
+
+    ESPTime now = clock_->utcnow();
+    if (!now.is_valid()) return;
+    last_update_ms_ = millis();
+
+    SomfyPoeSolarTable::lookup(now.day_of_year, now.hour * 3600 + now.minute * 60 + now.second,
+                               &sun_elevation_, &sun_azimuth_, &sun_tan_elevation_);
+
+    for (Facade& facade : facades_) {
+      if (facade.enabled) update_facade(facade);
+    }
+  }
+
+ private:
+  static const uint32_t UPDATE_INTERVAL_MS = 60000;
+
+  struct Facade {
+    float azimuth;
+    std::vector<SomfyPoeMotor*> motors;
+    float shaded_position;
+    float open_position;
+    float min_elevation;
+    float sun_depth = 0.0f;  // Window heights, 0 = on/off
+    bool enabled = true;
+    float last_target = NAN;
+  };
+
+  time::RealTimeClock* clock_;
+  SomfyPoeHub* hub_;
+  std::vector<Facade> facades_;
+  float threshold_;
+  uint32_t last_update_ms_;
+  float sun_elevation_;
+  float sun_azimuth_;
+  float sun_tan_elevation_;
+
+  void update_facade(Facade& facade) {
+    float offset = fabsf(fmodf(sun_azimuth_ - facade.azimuth + 540.0f, 360.0f) - 180.0f);
+    bool in_sun = sun_elevation_ > facade.min_elevation && offset < 90.0f;
+    float target = in_sun ? facade.shaded_position : facade.open_position;
+    if (in_sun && facade.sun_depth > 0.0f) {
+      // Sun height in the plane of the facade's normal (profile angle). An
+      // opening of h window heights lets sun in h / tan(profile) deep.
+      float tan_profile = sun_tan_elevation_ / SomfyPoeCosineTable::lookup(offset);
+      float opening = std::max(0.0f, std::min(1.0f, facade.sun_depth * tan_profile));
+      target += (facade.open_position - facade.shaded_position) * opening;
+    }
+
+    if (!std::isnan(facade.last_target) && fabsf(target - facade.last_target) < threshold_) return;
+    facade.last_target = target;
+
+    ESP_LOGD("somfy_poe", "Facade %.0f: sun at %.1f/%.1f, moving %u motor(s) to %.0f%%", facade.azimuth,
+             sun_elevation_, sun_azimuth_, (unsigned) facade.motors.size(), target);
+
+    if (hub_ != nullptr) {
+      std::vector<SomfyPoeSceneTarget> targets;
+      for (SomfyPoeMotor* motor : facade.motors) targets.push_back({motor, target});
+      hub_->apply_scene(targets);
+      return;
+    }
+    for (SomfyPoeMotor* motor : facade.motors) {
+      motor->move_to_position(target);
+    }
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,171 @@
+/*
+ * Fixed slab pool for Somfy PoE packet buffers
+ *
+ * All motors on the controller share one statically allocated arena for
+ * transmit, receive and retransmit buffers, split into a few size classes
+ * matched to typical message sizes. Allocation and release are O(1) bit
+ * operations, so steady-state UDP traffic never touches the general heap
+ * or fragments it between String allocations.
+ *
+ * When every slot of the fitting class and all larger classes is in use,
+ * the buffer falls back to the heap and the exhaustion is counted; raise
+ * SOMFY_POE_SLAB_MOTORS or the slot counts below (e.g. via build_flags) if
+ * that counter grows.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Motors that may have requests in flight at once, e.g. in one scene. Each
+// keeps up to 4 encrypted requests for retransmission.
+#ifndef SOMFY_POE_SLAB_MOTORS
+#define SOMFY_POE_SLAB_MOTORS 4
+#endif
+
+// Slots per size class
+#ifndef SOMFY_POE_SLAB_SMALL_SLOTS
+#define SOMFY_POE_SLAB_SMALL_SLOTS (4 * SOMFY_POE_SLAB_MOTORS)  // 128 bytes: moves and queries
+#endif
+#ifndef SOMFY_POE_SLAB_MEDIUM_SLOTS
+#define SOMFY_POE_SLAB_MEDIUM_SLOTS 8   // 256 bytes: position and group replies
+#endif
+#ifndef SOMFY_POE_SLAB_LARGE_SLOTS
+#define SOMFY_POE_SLAB_LARGE_SLOTS 4    // 512 bytes: info and network replies
+#endif
+#ifndef SOMFY_POE_SLAB_JUMBO_SLOTS
+#define SOMFY_POE_SLAB_JUMBO_SLOTS 1    // 1536 bytes: anything up to the MTU
+#endif
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeSlabPool {
+ public:
+  static const size_t NUM_CLASSES = 4;
+
+  // The pool shared by every motor on this controller
+  static SomfyPoeSlabPool& instance() {
+    static SomfyPoeSlabPool pool;
+    return pool;
+  }
+
+  // Returns a buffer of at least `size` bytes. Never fails: if the pool is
+  // exhausted the buffer comes from the heap. Release with release().
+  uint8_t* allocate(size_t size) {
+    for (size_t c = 0; c < NUM_CLASSES; c++) {
+      SizeClass& size_class = classes_[c];
+      if (size > size_class.slot_size) continue;
+
+      for (size_t word = 0; word * 32 < size_class.slots; word++) {
+        uint32_t free_slots = ~size_class.used[word] & word_mask(size_class.slots, word);
+        if (free_slots == 0) continue;
+
+        uint32_t bit = __builtin_ctz(free_slots);
+        size_class.used[word] |= 1u << bit;
+        size_class.in_use++;
+        if (size_class.in_use > size_class.high_water) size_class.high_water = size_class.in_use;
+        return arena_ + size_class.offset + (word * 32 + bit) * size_class.slot_size;
+      }
+      // Full, try the next larger class
+    }
+
+    exhaustions_++;
+    return new uint8_t[size];
+  }
+
+  void release(uint8_t* buffer) {
+    if (buffer == nullptr) return;
+    if (buffer < arena_ || buffer >= arena_ + ARENA_SIZE) {
+      delete[] buffer;
+      return;
+    }
+
+    size_t offset = buffer - arena_;
+    for (size_t c = NUM_CLASSES; c-- > 0;) {
+      SizeClass& size_class = classes_[c];
+      if (offset < size_class.offset) continue;
+
+      uint32_t slot = (offset - size_class.offset) / size_class.slot_size;
+      size_class.used[slot / 32] &= ~(1u << (slot % 32));
+      size_class.in_use--;
+      return;
+    }
+  }
+
+  size_t get_slot_size(size_t size_class) const {
+    return classes_[size_class].slot_size;
+  }
+
+  size_t get_slot_count(size_t size_class) const {
+    return classes_[size_class].slots;
+  }
+
+  // Slots currently allocated in a class
+  size_t get_in_use(size_t size_class) const {
+    return classes_[size_class].in_use;
+  }
+
+  // Most slots ever allocated at once in a class
+  size_t get_high_water(size_t size_class) const {
+    return classes_[size_class].high_water;
+  }
+
+  // Allocations that had to fall back to the heap
+  uint32_t get_exhaustion_count() const {
+    return exhaustions_;
+  }
+
+ private:
+  static const size_t SMALL_SIZE = 128;
+  static const size_t MEDIUM_SIZE = 256;
+  static const size_t LARGE_SIZE = 512;
+  static const size_t JUMBO_SIZE = 1536;
+
+  static const size_t SMALL_BYTES = SMALL_SIZE * SOMFY_POE_SLAB_SMALL_SLOTS;
+  static const size_t MEDIUM_BYTES = MEDIUM_SIZE * SOMFY_POE_SLAB_MEDIUM_SLOTS;
+  static const size_t LARGE_BYTES = LARGE_SIZE * SOMFY_POE_SLAB_LARGE_SLOTS;
+  static const size_t JUMBO_BYTES = JUMBO_SIZE * SOMFY_POE_SLAB_JUMBO_SLOTS;
+  static const size_t ARENA_SIZE = SMALL_BYTES + MEDIUM_BYTES + LARGE_BYTES + JUMBO_BYTES;
+
+  // Bitmap words per class, enough for the class with the most slots
+  static const size_t SMALLER_MOST = SOMFY_POE_SLAB_SMALL_SLOTS > SOMFY_POE_SLAB_MEDIUM_SLOTS
+                                         ? SOMFY_POE_SLAB_SMALL_SLOTS
+                                         : SOMFY_POE_SLAB_MEDIUM_SLOTS;
+  static const size_t LARGER_MOST = SOMFY_POE_SLAB_LARGE_SLOTS > SOMFY_POE_SLAB_JUMBO_SLOTS
+                                        ? SOMFY_POE_SLAB_LARGE_SLOTS
+                                        : SOMFY_POE_SLAB_JUMBO_SLOTS;
+  static const size_t WORDS = ((SMALLER_MOST > LARGER_MOST ? SMALLER_MOST : LARGER_MOST) + 31) / 32;
+
+  struct SizeClass {
+    size_t slot_size;
+    size_t slots;
+    size_t offset;  // Into arena_
+    size_t in_use;
+    size_t high_water;
+    uint32_t used[WORDS];  // Bit per slot
+  };
+
+  // Slots that exist in 32-slot word `word` of a class
+  static uint32_t word_mask(size_t slots, size_t word) {
+    size_t remaining = slots - word * 32;
+    return remaining >= 32 ? 0xFFFFFFFFu : (1u << remaining) - 1;
+  }
+
+  SomfyPoeSlabPool()
+    : classes_{
+          {SMALL_SIZE, SOMFY_POE_SLAB_SMALL_SLOTS, 0, 0, 0, {}},
+          {MEDIUM_SIZE, SOMFY_POE_SLAB_MEDIUM_SLOTS, SMALL_BYTES, 0, 0, {}},
+          {LARGE_SIZE, SOMFY_POE_SLAB_LARGE_SLOTS, SMALL_BYTES + MEDIUM_BYTES, 0, 0, {}},
+          {JUMBO_SIZE, SOMFY_POE_SLAB_JUMBO_SLOTS, SMALL_BYTES + MEDIUM_BYTES + LARGE_BYTES, 0, 0, {}}},
+      exhaustions_(0) {
+  }
+
+  SizeClass classes_[NUM_CLASSES];
+  uint32_t exhaustions_;
+  alignas(16) uint8_t arena_[ARENA_SIZE];
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
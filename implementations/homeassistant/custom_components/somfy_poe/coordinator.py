@@ -31,6 +31,12 @@ class SomfyPoECoordinator(DataUpdateCoordinator):
             name=DOMAIN,
             update_interval=timedelta(seconds=UPDATE_INTERVAL),
         )
+        self.motor.add_push_listener(self._handle_push)
+
+    def _handle_push(self, message: Dict[str, Any]) -> None:
+        """Publish a position pushed by the motor without waiting for a poll."""
+        if "position" in message:
+            self.async_set_updated_data(message["position"])
 
     async def _async_update_data(self) -> Dict[str, Any]:
         """Fetch data from the motor."""
@@ -4,13 +4,14 @@ import json
 import logging
 import socket
 import ssl
-from typing import Optional, Dict, Any
+from typing import Any, Callable, Dict, List, Optional
 
 from Crypto.Cipher import AES
 from Crypto.Random import get_random_bytes
 from Crypto.Util.Padding import pad, unpad
 
 from .const import TCP_PORT, UDP_PORT
+from .native import SomfyPoENativeTransport
 
 _LOGGER = logging.getLogger(__name__)
 
@@ -33,6 +34,8 @@ class SomfyPoEMotorController:
         self.message_id = 1
         self._tcp_socket: Optional[ssl.SSLSocket] = None
         self._udp_socket: Optional[socket.socket] = None
+        self._transport: Optional[SomfyPoENativeTransport] = None
+        self._push_listeners: List[Callable[[Dict[str, Any]], None]] = []
         self._is_connected = False
         self._lock = asyncio.Lock()
 
@@ -61,8 +64,14 @@ class SomfyPoEMotorController:
                 if not await self._authorize():
                     return False
 
-                # Step 4: Setup UDP socket
-                await self._setup_udp()
+                # Step 4: Setup UDP, through the shared native socket if available
+                self._transport = SomfyPoENativeTransport.get()
+                if self._transport is not None:
+                    self._transport.register(
+                        self.host, self.target_id, self.aes_key, self._handle_push
+                    )
+                else:
+                    await self._setup_udp()
 
                 self._is_connected = True
                 _LOGGER.info("Successfully connected to motor at %s", self.host)
@@ -90,6 +99,10 @@ class SomfyPoEMotorController:
                     pass
                 self._udp_socket = None
 
+            if self._transport:
+                self._transport.unregister(self.host)
+                self._transport = None
+
             self._is_connected = False
             _LOGGER.debug("Disconnected from motor")
 
@@ -222,8 +235,30 @@ class SomfyPoEMotorController:
 
         return message.decode("utf-8")
 
+    def add_push_listener(self, listener: Callable[[Dict[str, Any]], None]) -> None:
+        """
+        Register a callback for unsolicited messages (e.g. position updates).
+
+        Pushes are only received through the native transport.
+        """
+        self._push_listeners.append(listener)
+
+    def _handle_push(self, message: Dict[str, Any]) -> None:
+        """Pass an unsolicited message to the listeners."""
+        for listener in self._push_listeners:
+            listener(message)
+
     async def _send_udp(self, message: Dict[str, Any]) -> Dict[str, Any]:
         """Send encrypted UDP message and receive response."""
+        if self._transport and self.aes_key:
+            params = message.get("params", {})
+            return await self._transport.request(
+                self.host,
+                message["method"],
+                params.get("position", -1.0),
+                params.get("seq", 0),
+            )
+
         if not self._udp_socket or not self.aes_key:
             raise ConnectionError("Not connected or not authorized")
 
@@ -0,0 +1,106 @@
+"""Native UDP backend for Somfy PoE motors.
+
+Uses the optional somfy_poe_native extension, built from implementations/linux.
+All motors share one UDP socket that the event loop watches. Replies are
+matched to requests by id. Unsolicited position pushes go to per-motor
+listeners. Without the extension, each motor falls back to its own blocking
+socket.
+"""
+import asyncio
+import json
+import logging
+from typing import Any, Callable, Dict, Optional, Tuple
+
+from .const import UDP_PORT
+
+try:
+    import somfy_poe_native
+except ImportError:  # Extension not built or not installed
+    somfy_poe_native = None
+
+_LOGGER = logging.getLogger(__name__)
+
+
+class SomfyPoENativeTransport:
+    """One UDP socket for every motor, driven by the asyncio event loop."""
+
+    _instance: Optional["SomfyPoENativeTransport"] = None
+
+    def __init__(self, loop: asyncio.AbstractEventLoop, port: int = UDP_PORT):
+        """
+        Open the shared socket and start watching it.
+
+        Args:
+            loop: Event loop to run on
+            port: Local UDP port; motors push position updates to 55055
+        """
+        self._loop = loop
+        self._engine = somfy_poe_native.Engine(port)
+        self._pending: Dict[Tuple[str, int], asyncio.Future] = {}
+        self._push_listeners: Dict[str, Callable[[Dict[str, Any]], None]] = {}
+        loop.add_reader(self._engine.fileno(), self._on_readable)
+
+    @classmethod
+    def get(cls) -> Optional["SomfyPoENativeTransport"]:
+        """Return the shared transport, or None if the extension is unavailable."""
+        if somfy_poe_native is None:
+            return None
+        if cls._instance is None:
+            loop = asyncio.get_running_loop()
+            try:
+                cls._instance = cls(loop)
+            except OSError as err:
+                _LOGGER.warning("Native UDP port unavailable (%s), pushes disabled", err)
+                cls._instance = cls(loop, 0)
+        return cls._instance
+
+    def register(
+        self,
+        host: str,
+        target_id: str,
+        key: bytes,
+        push_listener: Optional[Callable[[Dict[str, Any]], None]] = None,
+    ) -> None:
+        """Use a motor's session key for its requests and replies."""
+        self._engine.add_motor(host, target_id, key)
+        if push_listener is not None:
+            self._push_listeners[host] = push_listener
+
+    def unregister(self, host: str) -> None:
+        """Forget a motor and fail its outstanding requests."""
+        self._engine.remove_motor(host)
+        self._push_listeners.pop(host, None)
+        for (pending_host, _), future in list(self._pending.items()):
+            if pending_host == host and not future.done():
+                future.set_exception(ConnectionError("Motor disconnected"))
+
+    async def request(
+        self,
+        host: str,
+        method: str,
+        position: float = -1.0,
+        seq: int = 0,
+        timeout: float = 5.0,
+    ) -> Dict[str, Any]:
+        """Send a request and wait for the reply carrying its id."""
+        request_id = self._engine.send(host, method, position, seq)
+        future = self._loop.create_future()
+        self._pending[(host, request_id)] = future
+        try:
+            return await asyncio.wait_for(future, timeout)
+        finally:
+            self._pending.pop((host, request_id), None)
+
+    def _on_readable(self) -> None:
+        """Dispatch every datagram waiting on the socket."""
+        for host, request_id, text in self._engine.poll():
+            message = json.loads(text)
+            if request_id is not None:
+                future = self._pending.get((host, request_id))
+                if future is not None and not future.done():
+                    future.set_result(message)
+                continue
+
+            listener = self._push_listeners.get(host)
+            if listener is not None:
+                listener(message)
@@ -0,0 +1,156 @@
+/*
+ * Control socket benchmark
+ *
+ * Measures the per-command cost of the binary control API: from a client
+ * call to the motor's UDP datagram arriving, compared with calling the
+ * motor directly inside the daemon. A simulated motor on 127.0.0.3 answers
+ * the TLS handshake and every UDP request, and timestamps each move it
+ * receives. The daemon runs in its own thread, as somfy_poed does.
+ *
+ * The motor also measures its round trips with kernel timestamps, so the
+ * user-space and kernel views of the same replies are printed last.
+ *
+ * Everything runs twice, in separate processes: with the default event
+ * loop (poll() between passes) and in busy-poll mode on a pinned CPU. Busy
+ * polling only pays off with a CPU to spare for the loop.
+ */
+
+#include "somfy_poe_busy_poll.h"
+#include "somfy_poe_control.h"
+#include "somfy_poe_control_client.h"
+#include "simulated_motor.h"
+
+#include <sys/wait.h>
+#include <algorithm>
+
+using namespace esphome::somfy_poe;
+
+static const char* MOTOR_IP = "127.0.0.3";
+static const char* SOCKET_PATH = "/tmp/somfy_poe_bench.sock";
+
+struct Latencies {
+  std::vector<double> us;
+
+  void add(uint64_t start, uint64_t end) {
+    us.push_back((end - start) / 1000.0);
+  }
+
+  void print(const char* name) {
+    std::sort(us.begin(), us.end());
+    printf("%-34s p50 %7.1f us   p99 %7.1f us\n", name, us[us.size() / 2], us[us.size() * 99 / 100]);
+  }
+};
+
+static int run(size_t iterations, bool busy_poll) {
+  SimulatedMotor simulated(MOTOR_IP, iterations * 3);
+  if (!simulated.listen()) {
+    fprintf(stderr, "cannot bind %s:55055/55056\n", MOTOR_IP);
+    return 1;
+  }
+  std::thread motor_thread([&] { simulated.run(); });
+
+  SomfyPoeMotor motor(MOTOR_IP, "1234");
+  motor.set_rate_limit(1e9f, 1e9f);
+  motor.set_kernel_timestamps(true);
+  SomfyPoeHub hub;
+  hub.add_motor(&motor);
+  SomfyPoeControlServer server(&hub, SOCKET_PATH);
+  App.register_component(&motor);
+  App.register_component(&hub);
+  App.register_component(&server);
+
+  // The daemon's thread: a direct baseline first, then serve clients
+  Latencies direct;
+  std::atomic<bool> serving{false};
+  std::atomic<bool> done{false};
+  std::thread daemon_thread([&] {
+    if (busy_poll) somfy_poe_enter_busy_poll();
+    App.setup();
+    if (!motor.is_authenticated()) {
+      fprintf(stderr, "handshake with the simulated motor failed\n");
+      exit(1);
+    }
+    for (uint32_t i = 0; i < iterations; i++) {
+      uint64_t start = bench_now_ns();
+      motor.move_to_position(i % 2 ? 20.0f : 10.0f);
+      direct.add(start, simulated.arrival_of(i));
+      App.loop();
+    }
+    serving = true;
+    while (!done) {
+      App.loop();
+      if (!busy_poll) server.wait(5);
+    }
+  });
+  while (!serving) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  SomfyPoeControlClient client;
+  if (!client.connect(SOCKET_PATH)) {
+    fprintf(stderr, "cannot connect to %s\n", SOCKET_PATH);
+    return 1;
+  }
+
+  Latencies to_motor;
+  Latencies round_trip;
+  Latencies forced_to_motor;
+  Latencies snapshot;
+  uint32_t next_move = iterations;
+  std::vector<SomfyPoeControlState> states;
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint64_t start = bench_now_ns();
+    client.move_to(0, i % 2 ? 20.0f : 10.0f);
+    round_trip.add(start, bench_now_ns());
+    to_motor.add(start, simulated.arrival_of(next_move++));
+
+    start = bench_now_ns();
+    client.move_to(0, i % 2 ? 20.0f : 10.0f, true);
+    forced_to_motor.add(start, simulated.arrival_of(next_move++));
+
+    start = bench_now_ns();
+    client.snapshot(&states);
+    snapshot.add(start, bench_now_ns());
+
+    // Commands on cue come spaced out, so replies do not find the loop awake
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  printf("%s, %zu iterations\n", busy_poll ? "busy poll" : "event loop", iterations);
+  direct.print("direct call -> UDP at motor");
+  to_motor.print("client move_to -> UDP at motor");
+  forced_to_motor.print("client forced move -> UDP at motor");
+  round_trip.print("client move_to round trip");
+  snapshot.print("client snapshot round trip");
+
+  auto print_histogram = [](const char* name, const SomfyPoeLatencyHistogram& histogram) {
+    printf("%-34s p50 %7.1f us   p99 %7.1f us   (%u samples)\n", name, histogram.get_percentile_ms(50) * 1000,
+           histogram.get_percentile_ms(99) * 1000, (unsigned) histogram.get_count());
+  };
+  print_histogram("motor rtt, user space", motor.get_rtt_histogram());
+  print_histogram("motor rtt, kernel timestamps", motor.get_wire_rtt_histogram());
+  print_histogram("send call -> kernel transmit", motor.get_send_delay_histogram());
+  print_histogram("kernel receive -> read", motor.get_receive_delay_histogram());
+
+  done = true;
+  simulated.running = false;
+  daemon_thread.join();
+  motor_thread.join();
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+  host_log_level = HOST_LOG_ERROR;
+  if (sysconf(_SC_NPROCESSORS_ONLN) < 2) printf("note: one CPU, busy polling competes with the client\n");
+
+  // App is global, so each mode gets a fresh process
+  for (bool busy_poll : {false, true}) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) exit(run(iterations, busy_poll));
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    printf("\n");
+  }
+  return 0;
+}
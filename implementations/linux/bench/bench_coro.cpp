@@ -0,0 +1,81 @@
+/*
+ * Coroutine overhead benchmark
+ *
+ * Times one awaited operation against the same operation written with a
+ * raw callback. The motor's side is simulated: each operation registers
+ * for a move result, and the loop delivers that result on its next pass,
+ * as App.loop() would after the reply arrives. The network and the packet
+ * path (see bench_packet) are left out, so only the continuation machinery
+ * is measured.
+ */
+
+#include "somfy_poe_coro.h"
+
+#include <chrono>
+
+using namespace esphome::somfy_poe;
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start, size_t iterations) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Each awaited move in its own child task, so a frame is allocated per operation
+static SomfyPoeTask<bool> one_move(SomfyPoeMoveWaiters& waiters, uint32_t seq) {
+  co_return co_await SomfyPoeMoveResultAwaiter(waiters, seq);
+}
+
+static SomfyPoeTask<size_t> move_sequence(SomfyPoeMoveWaiters& waiters, size_t iterations, bool child_tasks) {
+  size_t succeeded = 0;
+  for (uint32_t seq = 1; seq <= iterations; seq++) {
+    bool ok = child_tasks ? co_await one_move(waiters, seq) : co_await SomfyPoeMoveResultAwaiter(waiters, seq);
+    if (ok) succeeded++;
+  }
+  co_return succeeded;
+}
+
+int main(int argc, char** argv) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  SomfyPoeEventLoop& loop = SomfyPoeEventLoop::instance();
+
+  // Raw callbacks: each completion issues the next operation
+  CallbackManager<void(uint32_t, bool)> move_result;
+  size_t callback_succeeded = 0;
+  uint32_t next_seq = 1;
+  std::function<void(uint32_t, bool)> on_result = [&](uint32_t, bool ok) {
+    if (ok) callback_succeeded++;
+    next_seq++;
+  };
+  move_result.add([&](uint32_t seq, bool ok) { on_result(seq, ok); });
+
+  auto start = std::chrono::steady_clock::now();
+  while (next_seq <= iterations) move_result.call(next_seq, true);
+  double callback_ns = elapsed_ns(start, iterations);
+
+  // Coroutines, awaiting in place and through a child task per operation
+  double coroutine_ns[2];
+  size_t coroutine_succeeded[2];
+  for (int child_tasks = 0; child_tasks < 2; child_tasks++) {
+    SomfyPoeMoveWaiters waiters;
+    SomfyPoeTask<size_t> task = move_sequence(waiters, iterations, child_tasks);
+
+    start = std::chrono::steady_clock::now();
+    task.start();
+    for (uint32_t seq = 1; !task.done(); seq++) {
+      waiters.on_result(seq, true);
+      loop.resume_ready();
+    }
+    coroutine_ns[child_tasks] = elapsed_ns(start, iterations);
+    coroutine_succeeded[child_tasks] = task.result();
+  }
+
+  SomfyPoeFramePool& pool = SomfyPoeFramePool::instance();
+  printf("iterations:            %zu\n", iterations);
+  printf("raw callback:          %8.1f ns/op\n", callback_ns);
+  printf("co_await:              %8.1f ns/op\n", coroutine_ns[0]);
+  printf("co_await child task:   %8.1f ns/op\n", coroutine_ns[1]);
+  printf("frames in use (peak):  %zu, heap fallbacks: %u\n", pool.get_high_water(),
+         (unsigned) pool.get_fallback_count());
+  return callback_succeeded != iterations || coroutine_succeeded[0] != iterations ||
+         coroutine_succeeded[1] != iterations;
+}
@@ -0,0 +1,79 @@
+/*
+ * Fleet database benchmark
+ *
+ * For growing fleets (every motor with two groups and a cached session),
+ * compares loading the text config with opening the compiled database, and
+ * times lookups by IP and targetID in the mapped file. Files are written
+ * to /tmp.
+ *
+ *   ./build/bench_fleet_db [largest fleet]
+ */
+
+#include "somfy_poe_fleet_db_builder.h"
+
+#include <chrono>
+
+using namespace esphome::somfy_poe;
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string ip_of(uint32_t i) {
+  return "10." + std::to_string(i >> 16) + "." + std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff);
+}
+
+static char* target_of(uint32_t i, char* buffer) {
+  snprintf(buffer, 16, "%08x", i * 2654435761u);  // Spread like real IDs
+  return buffer;
+}
+
+int main(int argc, char** argv) {
+  uint32_t largest = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  const char* config_path = "/tmp/bench_fleet.conf";
+  const char* db_path = "/tmp/bench_fleet.db";
+  const uint32_t LOOKUPS = 100000;
+
+  printf("%9s %14s %14s %14s %14s\n", "motors", "parse text", "open db", "find by ip", "find by target");
+  for (uint32_t count = 100; count <= largest; count *= 10) {
+    FILE* config = fopen(config_path, "w");
+    char target[16];
+    for (uint32_t i = 0; i < count; i++) {
+      fprintf(config, "%s 1234 groups=floor%u,side%u target=%s key=000102030405060708090a0b0c0d0e0f\n",
+              ip_of(i).c_str(), i / 100, i % 4, target_of(i, target));
+    }
+    fclose(config);
+
+    auto start = std::chrono::steady_clock::now();
+    SomfyPoeFleetDbBuilder builder;
+    if (!builder.load_config(config_path)) return 1;
+    double parse_us = elapsed_us(start);
+    if (!builder.write(db_path)) return 1;
+
+    start = std::chrono::steady_clock::now();
+    SomfyPoeFleetDb fleet;
+    if (!fleet.open(db_path)) return 1;
+    double open_us = elapsed_us(start);
+
+    uint32_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+      found += fleet.find_by_ip(ip_of(i * 7919 % count).c_str()) != nullptr;
+    }
+    double ip_ns = elapsed_us(start) * 1000 / LOOKUPS;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+      found += fleet.find_by_target_id(target_of(i * 7919 % count, target)) != nullptr;
+    }
+    double target_ns = elapsed_us(start) * 1000 / LOOKUPS;
+    if (found != 2 * LOOKUPS) {
+      fprintf(stderr, "lookups failed\n");
+      return 1;
+    }
+
+    printf("%9u %11.0f us %11.1f us %11.0f ns %11.0f ns\n", count, parse_us, open_us, ip_ns, target_ns);
+  }
+  unlink(config_path);
+  unlink(db_path);
+  return 0;
+}
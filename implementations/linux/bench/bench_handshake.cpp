@@ -0,0 +1,149 @@
+/*
+ * Reconnect storm benchmark
+ *
+ * A connected motor (127.0.0.3) gets a move every millisecond from the loop
+ * thread while a storm of motors (127.0.1.1 up) all reconnect at once, as
+ * after a PoE switch reboot. The simulated motors take a while to answer
+ * each handshake request, like real ones. For the connected motor, the
+ * command latency runs from when each move was due to its arrival at the
+ * simulated motor; it is reported before and during the storm, with
+ * handshakes on the loop thread and on the worker pool.
+ *
+ * Storm motors are not registered with App: only their sessions matter.
+ *
+ *   ./build/bench_handshake [motors] [reply delay ms] [workers]
+ */
+
+#include "somfy_poe_handshake_pool.h"
+#include "simulated_motor.h"
+
+#include <sys/wait.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+using namespace esphome::somfy_poe;
+
+static const uint64_t COMMAND_PERIOD_NS = 1000000;
+static const uint64_t QUIET_NS = 300000000;  // Before and after the storm
+
+struct Latencies {
+  std::vector<double> us;
+
+  void print(const char* name) {
+    std::sort(us.begin(), us.end());
+    if (us.empty()) {
+      printf("%-24s no commands\n", name);
+      return;
+    }
+    printf("%-24s p50 %9.1f us   p99 %9.1f us   max %9.1f us   (%zu moves)\n", name, us[us.size() / 2],
+           us[us.size() * 99 / 100], us.back(), us.size());
+  }
+};
+
+static int run(size_t storm_size, uint32_t reply_delay_ms, size_t workers, bool pooled) {
+  SimulatedMotor simulated("127.0.0.3", 1 << 20, "0.0.0.0", reply_delay_ms);
+  if (!simulated.listen()) {
+    fprintf(stderr, "cannot bind 127.0.0.3:55055 and 0.0.0.0:55056\n");
+    return 1;
+  }
+  std::thread motor_thread([&]() { simulated.run(); });
+
+  SomfyPoeMotor motor("127.0.0.3", "1234");
+  motor.set_rate_limit(1e9f, 1e9f);
+  App.register_component(&motor);
+
+  std::deque<std::string> ips;
+  std::vector<std::unique_ptr<SomfyPoeMotor>> storm;
+  for (size_t i = 0; i < storm_size; i++) {
+    ips.push_back("127.0." + std::to_string(1 + i / 250) + "." + std::to_string(1 + i % 250));
+    storm.emplace_back(new SomfyPoeMotor(ips.back().c_str(), "1234"));
+  }
+
+  SomfyPoeHandshakePool pool(workers);
+  App.register_component(&pool);
+  if (pooled) {
+    for (auto& storm_motor : storm) pool.attach(storm_motor.get());
+  }
+
+  App.setup();
+  if (!motor.is_authenticated()) {
+    fprintf(stderr, "handshake with the simulated motor failed\n");
+    return 1;
+  }
+
+  std::vector<uint64_t> due;
+  uint64_t start = bench_now_ns();
+  uint64_t next_command = start;
+  uint64_t storm_start = 0;
+  uint64_t storm_end = 0;
+  while (storm_end == 0 || bench_now_ns() < storm_end + QUIET_NS) {
+    App.loop();
+    uint64_t now = bench_now_ns();
+    // Moves due while the loop was busy go out late, back to back
+    while (next_command <= now) {
+      due.push_back(next_command);
+      motor.move_to_position(due.size() % 2 ? 20.0f : 10.0f, true);
+      next_command += COMMAND_PERIOD_NS;
+    }
+
+    if (storm_start == 0 && now >= start + QUIET_NS) {
+      storm_start = now;
+      for (auto& storm_motor : storm) storm_motor->reconnect();
+    }
+    if (storm_start != 0 && storm_end == 0 &&
+        std::none_of(storm.begin(), storm.end(), [](const std::unique_ptr<SomfyPoeMotor>& m) {
+          return m->is_handshaking();
+        })) {
+      storm_end = bench_now_ns();
+    }
+  }
+
+  Latencies before;
+  Latencies during;
+  Latencies after;
+  for (uint32_t i = 0; i < due.size(); i++) {
+    uint64_t arrival = simulated.arrival_of(i);
+    if (arrival == 0) continue;
+    Latencies& phase = due[i] < storm_start ? before : (due[i] <= storm_end ? during : after);
+    phase.us.push_back((arrival - due[i]) / 1000.0);
+  }
+  size_t connected = std::count_if(storm.begin(), storm.end(), [](const std::unique_ptr<SomfyPoeMotor>& m) {
+    return m->is_authenticated();
+  });
+
+  if (pooled) {
+    printf("handshakes on %zu workers\n", workers);
+  } else {
+    printf("handshakes on the loop thread\n");
+  }
+  printf("storm: %zu/%zu motors reconnected in %.0f ms\n", connected, storm_size, (storm_end - storm_start) / 1e6);
+  before.print("before the storm");
+  during.print("during the storm");
+  after.print("after the storm");
+
+  simulated.running = false;
+  motor_thread.join();
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t storm_size = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500;
+  uint32_t reply_delay_ms = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20;
+  size_t workers = argc > 3 ? strtoul(argv[3], nullptr, 10) : 8;
+  host_log_level = HOST_LOG_ERROR;
+  printf("%zu motors reconnecting, %u ms per handshake reply, a move every 1 ms to a connected motor\n\n",
+         storm_size, reply_delay_ms);
+
+  // App is global, so each mode gets a fresh process
+  for (bool pooled : {false, true}) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) exit(run(storm_size, reply_delay_ms, workers, pooled));
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Packet path benchmark
+ *
+ * Times the per-command work on the UDP path using the same codec and
+ * request layout as the ESPHome component: build the JSON request, encrypt
+ * it, then decrypt and parse a position reply.
+ */
+
+#include "somfy_poe_component.h"
+
+#include <chrono>
+
+using namespace esphome::somfy_poe;
+using Codec = SomfyPoePacketCodec<SomfyPoeLinuxPlatform>;
+
+template <typename F> static double time_ns(size_t iterations, F&& body) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) body(i);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+
+  Codec codec;
+  uint8_t key[16];
+  SomfyPoeLinuxPlatform::random_bytes(key, sizeof(key));
+  codec.set_key(key);
+
+  char request[256];
+  uint8_t packet[256];
+  size_t sink = 0;
+
+  double build_ns = time_ns(iterations, [&](size_t i) {
+    StaticJsonDocument<512> doc;
+    doc["id"] = (uint32_t) i;
+    doc["method"] = "move.to";
+    JsonObject params = doc.createNestedObject("params");
+    params["targetID"] = "4a2b8c6d";
+    params["seq"] = (uint32_t) i;
+    params["position"] = 42.5f;
+    sink += serializeJson(doc, request, sizeof(request));
+  });
+  size_t request_len = strlen(request);
+
+  double encrypt_ns = time_ns(iterations, [&](size_t) {
+    sink += codec.encrypt(request, request_len, packet, sizeof(packet));
+  });
+
+  const char* reply = "{\"id\":7,\"position\":{\"value\":42.5,\"direction\":\"down\"}}";
+  uint8_t encrypted_reply[256];
+  size_t reply_len = codec.encrypt(reply, strlen(reply), encrypted_reply, sizeof(encrypted_reply));
+
+  double decrypt_ns = time_ns(iterations, [&](size_t) {
+    uint8_t work[256];
+    memcpy(work, encrypted_reply, reply_len);
+    size_t message_len = 0;
+    const char* message = codec.decrypt(work, reply_len, &message_len);
+    StaticJsonDocument<1024> doc;
+    deserializeJson(doc, message, message_len);
+    sink += doc["position"]["value"].as<float>() > 0;
+  });
+
+  printf("iterations:        %zu\n", iterations);
+  printf("build request:     %8.0f ns\n", build_ns);
+  printf("encrypt:           %8.0f ns\n", encrypt_ns);
+  printf("decrypt + parse:   %8.0f ns\n", decrypt_ns);
+  printf("total per command: %8.0f ns\n", build_ns + encrypt_ns + decrypt_ns);
+  return sink == 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * A motor simulated on the loopback interface, for the benchmarks
+ *
+ * Answers the TLS handshake (any number of connections at once, each on its
+ * own thread) and every UDP request with {"id": ..., "result": true}, and
+ * timestamps each move it receives by its seq, so retransmissions do not
+ * count twice. Every session gets the key key_base..key_base + 15, so
+ * motors simulated with different bases cannot read each other's packets.
+ */
+
+#pragma once
+
+#include "somfy_poe_component.h"
+
+#include <openssl/x509.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+inline uint64_t bench_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class SimulatedMotor {
+ public:
+  std::atomic<uint32_t> moves{0};  // Highest seq seen
+  std::vector<uint64_t> arrivals;  // First arrival of each seq, from 1
+  std::atomic<uint32_t> handshakes{0};
+  std::atomic<bool> running{true};
+
+  // UDP at `ip`; handshakes at `tls_ip` (0.0.0.0 answers every loopback
+  // address), each reply delayed by `reply_delay_ms` like a slow motor
+  SimulatedMotor(const char* ip, size_t max_moves, const char* tls_ip = nullptr, uint32_t reply_delay_ms = 0,
+                 uint8_t key_base = 0)
+      : arrivals(max_moves),
+        ip_(ip),
+        tls_ip_(tls_ip != nullptr ? tls_ip : ip),
+        reply_delay_ms_(reply_delay_ms),
+        key_base_(key_base) {}
+
+  ~SimulatedMotor() {
+    running = false;
+    if (acceptor_.joinable()) acceptor_.join();
+    for (std::thread& session : sessions_) session.join();
+  }
+
+  bool listen() {
+    udp_ = bind_socket(ip_, SOCK_DGRAM, 55055);
+    tcp_ = bind_socket(tls_ip_, SOCK_STREAM, 55056);
+    return udp_ >= 0 && tcp_ >= 0 && ::listen(tcp_, 1024) == 0;
+  }
+
+  // Serves UDP on the calling thread until `running` is cleared
+  void run() {
+    acceptor_ = std::thread([this]() { accept_sessions(); });
+
+    uint8_t key[16];
+    for (int i = 0; i < 16; i++) key[i] = key_base_ + i;
+    SomfyPoePacketCodec<SomfyPoeLinuxPlatform> codec;
+    codec.set_key(key);
+
+    uint8_t packet[1536];
+    while (running) {
+      struct pollfd readable = {udp_, POLLIN, 0};
+      if (poll(&readable, 1, 100) <= 0) continue;
+
+      struct sockaddr_in sender;
+      socklen_t sender_len = sizeof(sender);
+      ssize_t n = recvfrom(udp_, packet, sizeof(packet), 0, (struct sockaddr*) &sender, &sender_len);
+      if (n <= 0) continue;
+      uint64_t arrival = bench_now_ns();
+
+      size_t message_len = 0;
+      const char* message = codec.decrypt(packet, n, &message_len);
+      if (message == nullptr) continue;
+
+      StaticJsonDocument<256> request;
+      deserializeJson(request, message, message_len);
+      uint32_t seq = request["params"]["seq"].as<uint32_t>();  // 0 if not a move
+      if (seq > 0 && seq <= arrivals.size()) {
+        if (arrivals[seq - 1] == 0) arrivals[seq - 1] = arrival;
+        if (seq > moves.load(std::memory_order_relaxed)) moves.store(seq, std::memory_order_release);
+      }
+
+      char reply[64];
+      int reply_len = snprintf(reply, sizeof(reply), "{\"id\":%u,\"result\":true}", request["id"].as<uint32_t>());
+      uint8_t encrypted[128];
+      size_t encrypted_len = codec.encrypt(reply, reply_len, encrypted, sizeof(encrypted));
+      sendto(udp_, encrypted, encrypted_len, 0, (struct sockaddr*) &sender, sender_len);
+    }
+  }
+
+  // Waits for the move with seq index + 1 (or a later one) to arrive, and
+  // returns its arrival time (0 if it never came)
+  uint64_t arrival_of(uint32_t index) {
+    while (moves.load(std::memory_order_acquire) <= index) std::this_thread::yield();
+    return arrivals[index];
+  }
+
+ private:
+  const char* ip_;
+  const char* tls_ip_;
+  uint32_t reply_delay_ms_;
+  uint8_t key_base_;
+  int udp_ = -1;
+  int tcp_ = -1;
+  std::thread acceptor_;
+  std::vector<std::thread> sessions_;
+
+  static int bind_socket(const char* ip, int type, uint16_t port) {
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Self-signed certificate, as on a real motor
+  static SSL_CTX* make_context() {
+    EVP_PKEY* pkey = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*) "motor", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, pkey, EVP_sha256());
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(ctx, cert);
+    SSL_CTX_use_PrivateKey(ctx, pkey);
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ctx;
+  }
+
+  void accept_sessions() {
+    while (running) {
+      struct pollfd readable = {tcp_, POLLIN, 0};
+      if (poll(&readable, 1, 100) <= 0) continue;
+      int fd = accept4(tcp_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) sessions_.emplace_back([this, fd]() { serve_session(fd); });
+    }
+  }
+
+  void serve_session(int fd) {
+    static SSL_CTX* ctx = make_context();
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1) {
+      for (int step = 0; step < 2; step++) {
+        char request[512];
+        int n = SSL_read(ssl, request, sizeof(request) - 1);
+        if (n <= 0) break;
+        request[n] = '\0';
+        if (reply_delay_ms_ > 0) std::this_thread::sleep_for(std::chrono::milliseconds(reply_delay_ms_));
+        std::string reply = "{\"id\":1,\"result\":true,\"targetID\":\"4a2b8c6d\"}";
+        if (strstr(request, "security.auth") == nullptr) {
+          reply = "{\"id\":2,\"result\":true,\"key\":[";
+          for (int i = 0; i < 16; i++) reply += (i > 0 ? "," : "") + std::to_string((uint8_t) (key_base_ + i));
+          reply += "]}";
+        }
+        SSL_write(ssl, reply.data(), reply.size());
+      }
+      handshakes++;
+    }
+    SSL_free(ssl);
+    close(fd);
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
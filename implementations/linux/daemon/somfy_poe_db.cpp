@@ -0,0 +1,72 @@
+/*
+ * somfy_poe_db: compiles and inspects fleet databases for somfy_poed
+ *
+ *   somfy_poe_db compile fleet.conf fleet.db    text config to database
+ *   somfy_poe_db dump fleet.db                  database to text config
+ *   somfy_poe_db find fleet.db 192.168.1.150    lookup by IP or targetID
+ *
+ * See somfy_poe_fleet_db_builder.h for the config format. dump prints the
+ * sessions the daemon cached as well, so its output compiles back to the
+ * same database.
+ */
+
+#include "somfy_poe_fleet_db_builder.h"
+
+using namespace esphome::somfy_poe;
+
+static int usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s compile config database\n"
+          "       %s dump database\n"
+          "       %s find database ip|targetID\n",
+          program, program, program);
+  return 2;
+}
+
+static bool open_database(SomfyPoeFleetDb* db, const char* path) {
+  if (db->open(path)) return true;
+  fprintf(stderr, "%s is not a fleet database (version %u)\n", path, (unsigned) SOMFY_POE_FLEET_VERSION);
+  return false;
+}
+
+int main(int argc, char** argv) {
+  host_log_level = HOST_LOG_ERROR;
+  std::string command = argc > 1 ? argv[1] : "";
+
+  if (command == "compile" && argc == 4) {
+    SomfyPoeFleetDbBuilder builder;
+    if (!builder.load_config(argv[2]) || !builder.write(argv[3])) return 1;
+    printf("%s: %zu motors\n", argv[3], builder.get_count());
+    return 0;
+  }
+
+  if (command == "dump" && argc == 3) {
+    SomfyPoeFleetDb db;
+    if (!open_database(&db, argv[2])) return 1;
+    for (uint32_t i = 0; i < db.get_count(); i++) {
+      const SomfyPoeFleetRecord* record = db.get_record(i);
+      if (record == nullptr) {
+        fprintf(stderr, "record %u is damaged\n", i);
+        return 1;
+      }
+      printf("%s\n", SomfyPoeFleetDbBuilder::format_line(SomfyPoeFleetDbBuilder::entry_of(db, record)).c_str());
+    }
+    return 0;
+  }
+
+  if (command == "find" && argc == 4) {
+    SomfyPoeFleetDb db;
+    if (!open_database(&db, argv[2])) return 1;
+    const SomfyPoeFleetRecord* record = db.find_by_ip(argv[3]);
+    if (record == nullptr) record = db.find_by_target_id(argv[3]);
+    if (record == nullptr) {
+      fprintf(stderr, "%s not found\n", argv[3]);
+      return 1;
+    }
+    printf("record %u: %s\n", db.index_of(record),
+           SomfyPoeFleetDbBuilder::format_line(SomfyPoeFleetDbBuilder::entry_of(db, record)).c_str());
+    return 0;
+  }
+
+  return usage(argv[0]);
+}
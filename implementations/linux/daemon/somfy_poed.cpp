@@ -0,0 +1,198 @@
+/*
+ * somfy_poed: Somfy PoE daemon
+ *
+ * Keeps sessions with the given motors, serves the binary control API
+ * (somfy_poe_control.h) on a Unix domain socket and publishes their states
+ * in shared memory (somfy_poe_state_export.h):
+ *
+ *   somfy_poed [-s /run/somfy_poe.sock] [-m /somfy_poe_state] [-v] 192.168.1.150:1234 192.168.1.151:5678
+ *
+ * With -t (or -H eth0 for NIC timestamps as well), latencies are measured
+ * with kernel timestamps and logged per motor on exit. -b [cpu] busy-polls
+ * on a pinned CPU instead of sleeping between loop passes
+ * (somfy_poe_busy_poll.h). -w workers runs TLS handshakes on a worker pool
+ * (somfy_poe_handshake_pool.h), so reconnects do not stall the loop.
+ *
+ * -d fleet.db adds the motors of a fleet database (somfy_poe_fleet_db.h,
+ * compiled by somfy_poe_db) and resumes their cached sessions and groups.
+ * Sessions established while running are saved back to it on exit.
+ */
+
+#include "somfy_poe_busy_poll.h"
+#include "somfy_poe_control.h"
+#include "somfy_poe_fleet_db_builder.h"
+#include "somfy_poe_handshake_pool.h"
+#include "somfy_poe_state_export.h"
+
+#include <csignal>
+#include <list>
+#include <memory>
+
+using namespace esphome::somfy_poe;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop_running(int) {
+  running = 0;
+}
+
+static void log_histogram(SomfyPoeMotor* motor, const char* name, const SomfyPoeLatencyHistogram& histogram) {
+  if (histogram.get_count() == 0) return;
+  ESP_LOGI("somfy_poe", "%s %-14s %6u samples  p50 %8.3f ms  p99 %8.3f ms", motor->get_motor_ip(), name,
+           (unsigned) histogram.get_count(), histogram.get_percentile_ms(50), histogram.get_percentile_ms(99));
+}
+
+// Rewrites the database if any of its motors has a new session. The
+// motors point into the old mapping, which stays valid after the rename.
+static void save_sessions(const SomfyPoeFleetDb& fleet, const char* path,
+                          const std::vector<std::unique_ptr<SomfyPoeMotor>>& motors) {
+  SomfyPoeFleetDbBuilder builder;
+  uint32_t changed = 0;
+  for (uint32_t i = 0; i < fleet.get_count(); i++) {
+    SomfyPoeFleetEntry entry = SomfyPoeFleetDbBuilder::entry_of(fleet, fleet.get_record(i));
+    SomfyPoeFleetEntry updated = entry;
+    const uint8_t* key = motors[i]->get_session_key();
+    if (key != nullptr) {
+      updated.has_session = true;
+      updated.target_id = motors[i]->get_target_id();
+      memcpy(updated.key, key, sizeof(updated.key));
+    }
+    bool is_new = key != nullptr && (!entry.has_session || entry.target_id != updated.target_id ||
+                                     memcmp(entry.key, key, sizeof(entry.key)) != 0);
+    // A session the database cannot hold leaves the old entry
+    if (is_new && builder.add(updated)) {
+      changed++;
+    } else {
+      builder.add(entry);
+    }
+  }
+  if (changed > 0 && builder.write(path)) {
+    ESP_LOGI("somfy_poe", "Saved %u new session(s) to %s", changed, path);
+  }
+}
+
+static int usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-s socket] [-m shm_name] [-t] [-H interface] [-b [cpu]] [-w workers]\n"
+          "          [-d fleet.db] [-v] [ip:pin ...]\n",
+          program);
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  const char* socket_path = "/run/somfy_poe.sock";
+  const char* shm_name = "/somfy_poe_state";
+  const char* hardware_interface = nullptr;
+  bool timestamps = false;
+  bool busy_poll = false;
+  int busy_poll_cpu = -1;
+  size_t handshake_workers = 0;
+  const char* fleet_path = nullptr;
+  std::list<std::string> ips;  // Motors keep pointers to these
+  std::list<std::string> pins;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-s" && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (arg == "-m" && i + 1 < argc) {
+      shm_name = argv[++i];
+    } else if (arg == "-t") {
+      timestamps = true;
+    } else if (arg == "-H" && i + 1 < argc) {
+      hardware_interface = argv[++i];
+      timestamps = true;
+    } else if (arg == "-b") {
+      busy_poll = true;
+      if (i + 1 < argc && strspn(argv[i + 1], "0123456789") == strlen(argv[i + 1])) busy_poll_cpu = atoi(argv[++i]);
+    } else if (arg == "-w" && i + 1 < argc) {
+      handshake_workers = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "-d" && i + 1 < argc) {
+      fleet_path = argv[++i];
+    } else if (arg == "-v") {
+      host_log_level = HOST_LOG_DEBUG;
+    } else if (arg.find(':') != std::string::npos && arg[0] != '-') {
+      ips.push_back(arg.substr(0, arg.find(':')));
+      pins.push_back(arg.substr(arg.find(':') + 1));
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (ips.empty() && fleet_path == nullptr) return usage(argv[0]);
+  // Outlives the motors, which keep pointers into its records
+  SomfyPoeFleetDb fleet;
+  if (fleet_path != nullptr && !fleet.open(fleet_path)) {
+    ESP_LOGE("somfy_poe", "%s is not a fleet database", fleet_path);
+    return 1;
+  }
+  // Before the motors' UDP socket opens
+  if (busy_poll) somfy_poe_enter_busy_poll(busy_poll_cpu);
+  if (hardware_interface != nullptr && !SomfyPoeLinuxPlatform::enable_hardware_timestamps(hardware_interface)) {
+    ESP_LOGW("somfy_poe", "No hardware timestamps on %s, using software ones", hardware_interface);
+  }
+
+  SomfyPoeHub hub;
+  std::vector<std::unique_ptr<SomfyPoeMotor>> motors;
+  // Database motors first, in record order (save_sessions relies on it)
+  for (uint32_t i = 0; i < fleet.get_count(); i++) {
+    const SomfyPoeFleetRecord* record = fleet.get_record(i);
+    if (record == nullptr) {
+      ESP_LOGE("somfy_poe", "%s: record %u is damaged", fleet_path, i);
+      return 1;
+    }
+    motors.emplace_back(new SomfyPoeMotor(record->ip, record->pin));
+    if (record->flags & SOMFY_POE_FLEET_HAS_SESSION) motors.back()->restore_session(record->target_id, record->key);
+    motors.back()->set_kernel_timestamps(timestamps);
+    App.register_component(motors.back().get());
+    hub.add_motor(motors.back().get());
+    if (record->group_count > 0) {
+      std::vector<std::string> groups;
+      fleet.get_groups(record, &groups);
+      motors.back()->restore_groups(groups);
+    }
+  }
+  if (fleet.is_open()) {
+    ESP_LOGI("somfy_poe", "%u motors from %s, %u with cached sessions", fleet.get_count(), fleet_path,
+             fleet.get_session_count());
+  }
+  for (auto ip = ips.begin(), pin = pins.begin(); ip != ips.end(); ++ip, ++pin) {
+    motors.emplace_back(new SomfyPoeMotor(ip->c_str(), pin->c_str()));
+    motors.back()->set_kernel_timestamps(timestamps);
+    App.register_component(motors.back().get());
+    hub.add_motor(motors.back().get());
+  }
+  // After the motors, so its workers stop first
+  std::unique_ptr<SomfyPoeHandshakePool> handshakes;
+  if (handshake_workers > 0) {
+    handshakes.reset(new SomfyPoeHandshakePool(handshake_workers));
+    App.register_component(handshakes.get());
+    for (auto& motor : motors) handshakes->attach(motor.get());
+  }
+  SomfyPoeControlServer server(&hub, socket_path);
+  // One entry per motor, however large the fleet
+  SomfyPoeStateExport state_export(&hub, shm_name, fleet.get_count() + ips.size());
+  App.register_component(&hub);
+  App.register_component(&server);
+  App.register_component(&state_export);
+
+  signal(SIGINT, stop_running);
+  signal(SIGTERM, stop_running);
+
+  App.setup();
+  server.dump_config();
+  state_export.dump_config();
+  while (running) {
+    App.loop();
+    if (!busy_poll) server.wait(5);
+  }
+
+  // User-space and kernel views of the same traffic, for comparison
+  for (auto& motor : motors) {
+    log_histogram(motor.get(), "rtt", motor->get_rtt_histogram());
+    log_histogram(motor.get(), "wire rtt", motor->get_wire_rtt_histogram());
+    log_histogram(motor.get(), "send delay", motor->get_send_delay_histogram());
+    log_histogram(motor.get(), "receive delay", motor->get_receive_delay_histogram());
+  }
+  if (fleet.is_open()) save_sessions(fleet, fleet_path, motors);
+  return 0;
+}
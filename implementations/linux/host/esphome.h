@@ -0,0 +1,229 @@
+/*
+ * Minimal ESPHome runtime for standalone Linux builds
+ *
+ * The protocol headers in implementations/esphome are written against the
+ * ESPHome API. This header provides the small part of it they use, so the
+ * same headers build into ordinary Linux programs (benchmarks, daemons)
+ * without the ESPHome toolchain. Under ESPHome's own host platform, the
+ * real esphome.h is used instead.
+ *
+ * Programs register components with App and drive App.loop() themselves.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+
+#ifndef SOMFY_POE_LINUX
+#define SOMFY_POE_LINUX
+#endif
+
+namespace esphome {
+
+inline uint32_t micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) ((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+inline uint32_t millis() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+inline void delay(uint32_t ms) {
+  struct timespec ts = {(time_t) (ms / 1000), (long) (ms % 1000) * 1000000};
+  nanosleep(&ts, nullptr);
+}
+
+// Logging, filtered by esphome::host_log_level (0 = errors only, 5 = verbose)
+enum { HOST_LOG_ERROR = 1, HOST_LOG_WARN, HOST_LOG_INFO, HOST_LOG_CONFIG, HOST_LOG_DEBUG, HOST_LOG_VERBOSE };
+inline int host_log_level = HOST_LOG_INFO;
+
+inline void host_log(int level, const char* letter, const char* tag, const char* format, ...) {
+  if (level > host_log_level) return;
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "[%s][%s] ", letter, tag);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+#define ESP_LOGE(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_ERROR, "E", tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_WARN, "W", tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_INFO, "I", tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_CONFIG, "C", tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_DEBUG, "D", tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::esphome::host_log(::esphome::HOST_LOG_VERBOSE, "V", tag, __VA_ARGS__)
+
+inline uint32_t fnv1_hash(const std::string& str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= c;
+  }
+  return hash;
+}
+
+namespace setup_priority {
+const float DATA = 600.0f;
+const float LATE = -100.0f;
+}  // namespace setup_priority
+
+template <typename... Ts> class CallbackManager;
+template <typename... Ts> class CallbackManager<void(Ts...)> {
+ public:
+  void add(std::function<void(Ts...)>&& callback) {
+    callbacks_.push_back(std::move(callback));
+  }
+
+  void call(Ts... args) {
+    for (auto& callback : callbacks_) callback(args...);
+  }
+
+ private:
+  std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const {
+    return setup_priority::DATA;
+  }
+
+  // Runs due timeouts; called by Application::loop()
+  void run_timeouts() {
+    uint32_t now = millis();
+    for (size_t i = 0; i < timeouts_.size();) {
+      if ((int32_t) (now - timeouts_[i].first) >= 0) {
+        auto callback = std::move(timeouts_[i].second);
+        timeouts_.erase(timeouts_.begin() + i);
+        callback();
+      } else {
+        i++;
+      }
+    }
+  }
+
+ protected:
+  void set_timeout(uint32_t timeout, std::function<void()>&& callback) {
+    timeouts_.emplace_back(millis() + timeout, std::move(callback));
+  }
+
+ private:
+  std::vector<std::pair<uint32_t, std::function<void()>>> timeouts_;
+};
+
+// The loop is driven by the program, so there is nothing to speed up
+class HighFrequencyLoopRequester {
+ public:
+  void start() {}
+  void stop() {}
+};
+
+// Preferences kept in memory for the lifetime of the process
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t>* data) : data_(data) {}
+
+  template <typename T> bool save(const T* value) {
+    if (data_ == nullptr) return false;
+    data_->assign((const uint8_t*) value, (const uint8_t*) value + sizeof(T));
+    return true;
+  }
+
+  template <typename T> bool load(T* value) {
+    if (data_ == nullptr || data_->size() != sizeof(T)) return false;
+    memcpy(value, data_->data(), sizeof(T));
+    return true;
+  }
+
+ private:
+  std::vector<uint8_t>* data_ = nullptr;
+};
+
+class ESPPreferences {
+ public:
+  template <typename T> ESPPreferenceObject make_preference(uint32_t key, bool = false) {
+    return ESPPreferenceObject(&values_[key]);
+  }
+
+  bool sync() {
+    return true;
+  }
+
+ private:
+  std::map<uint32_t, std::vector<uint8_t>> values_;
+};
+
+inline ESPPreferences* global_preferences = new ESPPreferences();
+
+namespace sensor {
+class Sensor {
+ public:
+  void publish_state(float state) {
+    this->state = state;
+  }
+  float state = NAN;
+};
+}  // namespace sensor
+
+// Home Assistant services are not available outside ESPHome
+namespace api {
+class CustomAPIDevice {
+ public:
+  template <typename T, typename... Ts>
+  void register_service(void (T::*)(Ts...), const std::string&, const std::array<std::string, sizeof...(Ts)>&) {}
+  template <typename T> void register_service(void (T::*)(), const std::string&) {}
+  void fire_homeassistant_event(const std::string&, const std::map<std::string, std::string>& = {}) {}
+};
+}  // namespace api
+
+class Application {
+ public:
+  void register_component(Component* component) {
+    components_.push_back(component);
+  }
+
+  // Sets components up in priority order, as ESPHome does
+  void setup() {
+    std::stable_sort(components_.begin(), components_.end(), [](Component* a, Component* b) {
+      return a->get_setup_priority() > b->get_setup_priority();
+    });
+    for (Component* component : components_) component->setup();
+  }
+
+  void loop() {
+    for (Component* component : components_) {
+      component->run_timeouts();
+      component->loop();
+    }
+  }
+
+ private:
+  std::vector<Component*> components_;
+};
+
+inline Application App;
+
+}  // namespace esphome
+
+using namespace esphome;
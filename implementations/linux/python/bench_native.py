@@ -0,0 +1,133 @@
+"""Benchmark the Home Assistant integration's UDP paths.
+
+Compares the pure-Python path (blocking sendto/recvfrom in an executor) with
+the native transport (somfy_poe_native, one socket on the event loop). Both
+talk to a simulated motor, in a separate process, that answers every request
+on 127.0.0.2. The benchmark reports commands per second and latency with one
+command in flight and with many in flight, plus replies that reached the
+wrong request.
+
+Needs pycryptodome (as the integration does) and the extension built by the
+CMake project:
+
+    PYTHONPATH=build python3 python/bench_native.py [commands] [concurrency]
+"""
+import asyncio
+import importlib
+import json
+import multiprocessing
+import os
+import socket
+import statistics
+import sys
+import time
+import types
+
+from Crypto.Cipher import AES
+from Crypto.Random import get_random_bytes
+from Crypto.Util.Padding import pad, unpad
+
+MOTOR_HOST = "127.0.0.2"
+MOTOR_PORT = 55055
+KEY = bytes(range(16))
+TARGET_ID = "4a2b8c6d"
+
+# Import the integration's modules without Home Assistant (skips __init__.py)
+INTEGRATION = os.path.join(
+    os.path.dirname(__file__), "..", "..", "homeassistant", "custom_components", "somfy_poe"
+)
+package = types.ModuleType("somfy_poe")
+package.__path__ = [os.path.abspath(INTEGRATION)]
+sys.modules["somfy_poe"] = package
+motor_module = importlib.import_module("somfy_poe.motor")
+native_module = importlib.import_module("somfy_poe.native")
+
+
+def simulated_motor(ready) -> None:
+    """Answer every request with {"id": ..., "result": true}."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((MOTOR_HOST, MOTOR_PORT))
+    ready.set()
+    while True:
+        data, sender = sock.recvfrom(2048)
+        request = json.loads(unpad(AES.new(KEY, AES.MODE_CBC, data[:16]).decrypt(data[16:]), 16))
+        reply = json.dumps({"id": request["id"], "result": True}).encode()
+        iv = get_random_bytes(16)
+        sock.sendto(iv + AES.new(KEY, AES.MODE_CBC, iv).encrypt(pad(reply, 16)), sender)
+
+
+def report(name: str, latencies: list, elapsed: float, mismatched: int, failed: int) -> None:
+    latencies.sort()
+    p99 = latencies[int(len(latencies) * 0.99) - 1] if latencies else 0.0
+    print(
+        f"{name:<28} {len(latencies) / elapsed:9.0f} cmd/s"
+        f"   p50 {statistics.median(latencies) * 1e6 if latencies else 0:7.0f} us"
+        f"   p99 {p99 * 1e6:7.0f} us   mismatched {mismatched}   failed {failed}"
+    )
+
+
+async def run(name: str, send, commands: int, concurrency: int) -> None:
+    """Run `commands` requests, `concurrency` at a time."""
+    latencies = []
+    mismatched = 0
+    failed = 0
+    next_id = 1
+
+    async def worker() -> None:
+        nonlocal mismatched, failed, next_id
+        while next_id <= commands:
+            request_id = next_id
+            next_id += 1
+            start = time.perf_counter()
+            try:
+                reply = await send(request_id)
+            except Exception:  # Timeouts and socket errors
+                failed += 1
+                continue
+            latencies.append(time.perf_counter() - start)
+            if reply.get("id") != request_id and reply.get("id") is not None:
+                mismatched += 1
+
+    start = time.perf_counter()
+    await asyncio.gather(*(worker() for _ in range(concurrency)))
+    report(f"{name} x{concurrency}", latencies, time.perf_counter() - start, mismatched, failed)
+
+
+async def main(commands: int, concurrency: int) -> None:
+    # Pure Python: the controller's own socket, as without the extension
+    controller = motor_module.SomfyPoEMotorController(MOTOR_HOST, "0000")
+    controller.aes_key = KEY
+    controller.target_id = TARGET_ID
+    controller._is_connected = True
+    await controller._setup_udp()
+
+    async def python_send(request_id: int) -> dict:
+        message = {"id": request_id, "method": "move.to", "params": {"targetID": TARGET_ID, "position": 40.0}}
+        return await controller._send_udp(message)
+
+    # Native: the shared transport (on an ephemeral port, not 55055)
+    transport = native_module.SomfyPoENativeTransport(asyncio.get_running_loop(), 0)
+    transport.register(MOTOR_HOST, TARGET_ID, KEY)
+
+    async def native_send(request_id: int) -> dict:
+        reply = await transport.request(MOTOR_HOST, "move.to", 40.0)
+        reply.pop("id", None)  # The transport assigns its own ids and checks them
+        return reply
+
+    for level in (1, concurrency):
+        await run("python", python_send, commands, level)
+        await run("native", native_send, commands, level)
+
+
+if __name__ == "__main__":
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 5000
+    parallel = int(sys.argv[2]) if len(sys.argv) > 2 else 32
+
+    motor_ready = multiprocessing.Event()
+    motor = multiprocessing.Process(target=simulated_motor, args=(motor_ready,), daemon=True)
+    motor.start()
+    motor_ready.wait()
+    try:
+        asyncio.run(main(count, parallel))
+    finally:
+        motor.terminate()
@@ -0,0 +1,214 @@
+/*
+ * somfy_poe_native: Python extension for the Home Assistant integration
+ *
+ * Exposes the UDP side of the protocol implementation to Python. One Engine
+ * owns one socket for any number of motors. Requests are built and
+ * encrypted by the same code as the ESPHome component; received datagrams
+ * are decrypted with the sending motor's key and returned with their
+ * request id, so replies can be matched to requests and unsolicited pushes
+ * told apart. The TLS handshake that yields each motor's key stays in
+ * Python.
+ *
+ * Nothing here blocks: register fileno() with the event loop and call
+ * poll() whenever it is readable.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include "somfy_poe_component.h"
+
+#include <map>
+#include <string>
+
+using namespace esphome::somfy_poe;
+using Platform = SomfyPoeLinuxPlatform;
+
+namespace {
+
+const uint16_t MOTOR_UDP_PORT = 55055;
+
+struct NativeMotor {
+  std::string target_id;
+  SomfyPoePacketCodec<Platform> codec;
+};
+
+struct EngineObject {
+  PyObject_HEAD
+  Platform::Udp* udp;
+  std::map<std::string, NativeMotor>* motors;
+  uint32_t next_id;
+  unsigned int dropped;  // Datagrams from unknown senders or failing to decrypt
+};
+
+int engine_init(EngineObject* self, PyObject* args, PyObject* kwargs) {
+  unsigned int port = MOTOR_UDP_PORT;
+  static const char* keywords[] = {"port", nullptr};
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|I", (char**) keywords, &port)) return -1;
+
+  self->udp = new Platform::Udp();
+  self->motors = new std::map<std::string, NativeMotor>();
+  self->next_id = 1;
+  self->dropped = 0;
+  if (!self->udp->begin(port)) {
+    PyErr_SetFromErrno(PyExc_OSError);
+    return -1;
+  }
+  return 0;
+}
+
+void engine_dealloc(EngineObject* self) {
+  delete self->udp;
+  delete self->motors;
+  Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+PyObject* engine_fileno(EngineObject* self, PyObject*) {
+  return PyLong_FromLong(self->udp->fd());
+}
+
+PyObject* engine_add_motor(EngineObject* self, PyObject* args) {
+  const char* host;
+  const char* target_id;
+  const char* key;
+  Py_ssize_t key_len;
+  if (!PyArg_ParseTuple(args, "ssy#", &host, &target_id, &key, &key_len)) return nullptr;
+  if (key_len != 16) {
+    PyErr_SetString(PyExc_ValueError, "session key must be 16 bytes");
+    return nullptr;
+  }
+
+  NativeMotor& motor = (*self->motors)[host];
+  motor.target_id = target_id;
+  motor.codec.set_key((const uint8_t*) key);
+  Py_RETURN_NONE;
+}
+
+PyObject* engine_remove_motor(EngineObject* self, PyObject* args) {
+  const char* host;
+  if (!PyArg_ParseTuple(args, "s", &host)) return nullptr;
+  self->motors->erase(host);
+  Py_RETURN_NONE;
+}
+
+// send(host, method, position=-1.0, seq=0) -> request id
+PyObject* engine_send(EngineObject* self, PyObject* args, PyObject* kwargs) {
+  const char* host;
+  const char* method;
+  float position = -1.0f;
+  unsigned int seq = 0;
+  static const char* keywords[] = {"host", "method", "position", "seq", nullptr};
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|fI", (char**) keywords, &host, &method, &position, &seq)) {
+    return nullptr;
+  }
+
+  auto it = self->motors->find(host);
+  if (it == self->motors->end()) {
+    PyErr_Format(PyExc_KeyError, "no motor registered at %s", host);
+    return nullptr;
+  }
+
+  uint32_t id = self->next_id++;
+  char request[256];
+  size_t request_len = somfy_poe_build_request(request, sizeof(request), id, method, it->second.target_id.c_str(),
+                                               position, seq);
+  if (request_len == 0) {
+    PyErr_SetString(PyExc_ValueError, "request too large");
+    return nullptr;
+  }
+
+  uint8_t packet[sizeof(request) + 32];  // IV and padding
+  size_t packet_len = it->second.codec.encrypt(request, request_len, packet, sizeof(packet));
+  if (!self->udp->send_to(host, MOTOR_UDP_PORT, packet, packet_len)) {
+    PyErr_SetFromErrno(PyExc_OSError);
+    return nullptr;
+  }
+  return PyLong_FromUnsignedLong(id);
+}
+
+// poll() -> [(host, id or None, message JSON)] for every waiting datagram
+PyObject* engine_poll(EngineObject* self, PyObject*) {
+  PyObject* events = PyList_New(0);
+  if (events == nullptr) return nullptr;
+
+  uint8_t packet[1536];
+  char host[INET_ADDRSTRLEN];
+  int packet_len;
+  while ((packet_len = self->udp->receive_from(packet, sizeof(packet), host, sizeof(host))) > 0) {
+    auto it = self->motors->find(host);
+    if (it == self->motors->end()) {
+      self->dropped++;
+      continue;
+    }
+
+    size_t message_len = 0;
+    const char* message = it->second.codec.decrypt(packet, packet_len, &message_len);
+    StaticJsonDocument<1024> doc;
+    if (message == nullptr || deserializeJson(doc, message, message_len)) {
+      self->dropped++;
+      continue;
+    }
+
+    // Replies echo the request id; unsolicited pushes carry none
+    PyObject* id = doc.containsKey("id") ? PyLong_FromUnsignedLong(doc["id"].as<uint32_t>()) : Py_NewRef(Py_None);
+    PyObject* event = Py_BuildValue("(sNs#)", host, id, message, (Py_ssize_t) message_len);
+    if (event == nullptr || PyList_Append(events, event) < 0) {
+      Py_XDECREF(event);
+      Py_DECREF(events);
+      return nullptr;
+    }
+    Py_DECREF(event);
+  }
+  return events;
+}
+
+PyMethodDef engine_methods[] = {
+    {"fileno", (PyCFunction) engine_fileno, METH_NOARGS, "Socket to wait on for readability."},
+    {"add_motor", (PyCFunction) engine_add_motor, METH_VARARGS,
+     "add_motor(host, target_id, key): use a session key from the TLS handshake."},
+    {"remove_motor", (PyCFunction) engine_remove_motor, METH_VARARGS, "remove_motor(host)"},
+    {"send", (PyCFunction) engine_send, METH_VARARGS | METH_KEYWORDS,
+     "send(host, method, position=-1.0, seq=0) -> id: encrypt and send a request."},
+    {"poll", (PyCFunction) engine_poll, METH_NOARGS,
+     "poll() -> [(host, id or None, json)]: drain received datagrams without blocking."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyMemberDef engine_members[] = {
+    {"dropped", T_UINT, offsetof(EngineObject, dropped), READONLY, "Datagrams that could not be decrypted."},
+    {nullptr, 0, 0, 0, nullptr},
+};
+
+PyTypeObject engine_type = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "somfy_poe_native", "Somfy PoE UDP engine shared with the ESPHome component.", -1,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_somfy_poe_native() {
+  engine_type.tp_name = "somfy_poe_native.Engine";
+  engine_type.tp_doc = "Engine(port=55055): one UDP socket for many motors.";
+  engine_type.tp_basicsize = sizeof(EngineObject);
+  engine_type.tp_flags = Py_TPFLAGS_DEFAULT;
+  engine_type.tp_new = PyType_GenericNew;
+  engine_type.tp_init = (initproc) engine_init;
+  engine_type.tp_dealloc = (destructor) engine_dealloc;
+  engine_type.tp_methods = engine_methods;
+  engine_type.tp_members = engine_members;
+  if (PyType_Ready(&engine_type) < 0) return nullptr;
+
+  PyObject* module = PyModule_Create(&module_def);
+  if (module == nullptr) return nullptr;
+  Py_INCREF(&engine_type);
+  if (PyModule_AddObject(module, "Engine", (PyObject*) &engine_type) < 0) {
+    Py_DECREF(&engine_type);
+    Py_DECREF(module);
+    return nullptr;
+  }
+  return module;
+}
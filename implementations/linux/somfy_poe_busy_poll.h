@@ -0,0 +1,47 @@
+/*
+ * Low-latency busy-poll mode for the daemon loop
+ *
+ * By default the daemon sleeps in poll() between loop passes, so a reply or
+ * push waits for the next wakeup. In busy-poll mode the loop thread is
+ * pinned to a CPU of its own and runs App.loop() back to back: datagrams are
+ * read as soon as they arrive, and commands are sent inline from the same
+ * pass. Motor sockets also get SO_BUSY_POLL, so their reads poll the NIC's
+ * queue instead of waiting for its interrupt. This costs a whole CPU.
+ *
+ *   somfy_poe_enter_busy_poll(3);   // before App.setup()
+ *   while (running) App.loop();
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace esphome {
+namespace somfy_poe {
+
+// Pins the calling thread to `cpu` (-1 for the last one) and turns on
+// SO_BUSY_POLL for motor sockets opened afterwards. Each step that fails is
+// logged; the loop still spins, with more jitter.
+inline bool somfy_poe_enter_busy_poll(int cpu = -1, uint32_t socket_busy_poll_us = 50) {
+  bool ok = true;
+  if (cpu < 0) cpu = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+    ESP_LOGW("somfy_poe", "Cannot pin the loop thread to CPU %d", cpu);
+    ok = false;
+  }
+  if (!SomfyPoeLinuxPlatform::set_busy_poll(socket_busy_poll_us)) {
+    ESP_LOGW("somfy_poe", "SO_BUSY_POLL refused (needs CAP_NET_ADMIN), spinning without it");
+    ok = false;
+  }
+  ESP_LOGI("somfy_poe", "Busy-polling on CPU %d", cpu);
+  return ok;
+}
+
+}  // namespace somfy_poe
+}  // namespace esphome
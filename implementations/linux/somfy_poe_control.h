@@ -0,0 +1,411 @@
+/*
+ * Binary control API over a Unix domain socket
+ *
+ * Lets local tools drive the daemon without JSON. The server runs as a
+ * component next to the hub and addresses the hub's motors by index. See
+ * somfy_poe_control_protocol.h for the wire format and
+ * somfy_poe_control_client.h for a client.
+ */
+
+#pragma once
+
+#include "somfy_poe_control_protocol.h"
+#include "somfy_poe_hub.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+// A motor's state as reported to clients, without querying the motor
+inline SomfyPoeControlState somfy_poe_control_state(SomfyPoeMotor* motor) {
+  SomfyPoeControlState state = {};
+  state.position = motor->get_reported_position();
+  const char* status = motor->get_status();
+  state.direction = strcmp(status, "up") == 0 ? 1 : (strcmp(status, "down") == 0 ? 2 : 0);
+  state.health = (uint8_t) motor->get_health();
+  state.flags = (motor->is_authenticated() ? SOMFY_POE_STATE_AUTHENTICATED : 0) |
+                (motor->is_position_stale() ? SOMFY_POE_STATE_STALE : 0) |
+                (motor->is_locked() ? SOMFY_POE_STATE_LOCKED : 0) |
+                (motor->is_lock_stale() ? SOMFY_POE_STATE_LOCK_STALE : 0);
+  return state;
+}
+
+// Indices of the hub's motors whose state may have changed, collected from
+// the hub's change callbacks, so publishers visit only those instead of
+// the whole fleet on every loop pass. Removing a motor shifts the indices
+// after it, so it marks every motor.
+class SomfyPoeChangedMotors {
+ public:
+  explicit SomfyPoeChangedMotors(SomfyPoeHub* hub) {
+    hub->add_on_motor_changed_callback([this](size_t index) { this->mark(index); });
+    hub->add_on_motor_removed_callback([this](SomfyPoeMotor*) { this->mark_all(); });
+  }
+
+  // For motors added before this was created
+  void mark_all() {
+    all_ = true;
+  }
+
+  void mark(size_t index) {
+    if (index >= marked_.size()) marked_.resize(index + 1, false);
+    if (marked_[index]) return;
+    marked_[index] = true;
+    changed_.push_back(index);
+  }
+
+  // Calls visit(index) for each marked motor below `count`, then clears the marks
+  template <typename Visit> void take(size_t count, Visit visit) {
+    if (all_) {
+      for (size_t i = 0; i < count; i++) visit(i);
+    } else {
+      for (size_t index : changed_) {
+        if (index < count) visit(index);
+      }
+    }
+    for (size_t index : changed_) marked_[index] = false;
+    changed_.clear();
+    all_ = false;
+  }
+
+ private:
+  std::vector<size_t> changed_;
+  std::vector<bool> marked_;
+  bool all_ = false;
+};
+
+class SomfyPoeControlServer : public Component {
+ public:
+  SomfyPoeControlServer(SomfyPoeHub* hub, const std::string& path) : hub_(hub), path_(path), changed_(hub) {}
+
+  ~SomfyPoeControlServer() {
+    for (Client& client : clients_) close(client.fd);
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+      unlink(path_.c_str());
+    }
+  }
+
+  // After the hub, so its motors are registered
+  float get_setup_priority() const override {
+    return setup_priority::LATE - 1.0f;
+  }
+
+  void setup() override {
+    changed_.mark_all();
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path)) {
+      ESP_LOGE("somfy_poe", "Control socket path too long: %s", path_.c_str());
+      return;
+    }
+    strcpy(addr.sun_path, path_.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path_.c_str());
+    if (listen_fd_ < 0 || bind(listen_fd_, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+        listen(listen_fd_, 8) != 0) {
+      ESP_LOGE("somfy_poe", "Cannot listen on %s: %s", path_.c_str(), strerror(errno));
+      if (listen_fd_ >= 0) close(listen_fd_);
+      listen_fd_ = -1;
+    }
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE control socket: %s", path_.c_str());
+  }
+
+  void loop() override {
+    if (listen_fd_ < 0) return;
+    accept_clients();
+
+    for (Client& client : clients_) {
+      if (!client.closed) read_requests(&client);
+    }
+    publish_changes();
+
+    for (Client& client : clients_) {
+      if (!client.closed) flush(&client);
+    }
+    for (size_t i = 0; i < clients_.size();) {
+      if (clients_[i].closed) {
+        close(clients_[i].fd);
+        clients_.erase(clients_.begin() + i);
+      } else {
+        i++;
+      }
+    }
+  }
+
+  // Blocks until a client sends something, a motor's datagram arrives on
+  // the hub's socket or timeout_ms passes, for a daemon loop that should
+  // not spin
+  void wait(int timeout_ms) {
+    std::vector<struct pollfd> fds;
+    if (listen_fd_ >= 0) fds.push_back({listen_fd_, POLLIN, 0});
+    int udp_fd = hub_->get_udp_socket().get_udp().fd();
+    if (udp_fd >= 0) fds.push_back({udp_fd, POLLIN, 0});
+    for (const Client& client : clients_) {
+      fds.push_back({client.fd, (short) (client.out.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+    }
+    poll(fds.data(), fds.size(), timeout_ms);
+  }
+
+  size_t get_client_count() const {
+    return clients_.size();
+  }
+
+ private:
+  // Buffered output beyond this (plus one CHANGE per motor, for a new
+  // subscriber) drops the client rather than the daemon
+  static const size_t MAX_PENDING_OUTPUT = 256 * 1024;
+  static const size_t CHANGE_FRAME_SIZE = 4 + 1 + 4 + sizeof(SomfyPoeControlState);
+
+  struct Client {
+    int fd;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    bool subscribed = false;
+    bool closed = false;
+  };
+
+  SomfyPoeHub* hub_;
+  std::string path_;
+  int listen_fd_ = -1;
+  std::vector<Client> clients_;
+  SomfyPoeChangedMotors changed_;
+  std::vector<SomfyPoeControlState> published_;
+  std::vector<SomfyPoeSceneTarget> scene_;
+  std::vector<bool> scene_accepted_;
+
+  void accept_clients() {
+    int fd;
+    while ((fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+      Client client;
+      client.fd = fd;
+      clients_.push_back(std::move(client));
+    }
+  }
+
+  void read_requests(Client* client) {
+    uint8_t buffer[4096];
+    while (true) {
+      ssize_t n = recv(client->fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        client->in.insert(client->in.end(), buffer, buffer + n);
+        continue;
+      }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) client->closed = true;
+      break;
+    }
+
+    size_t offset = 0;
+    while (client->in.size() - offset >= 4) {
+      uint32_t length;
+      memcpy(&length, client->in.data() + offset, 4);
+      if (length == 0 || length > SOMFY_POE_CONTROL_MAX_FRAME) {
+        client->closed = true;
+        return;
+      }
+      if (client->in.size() - offset - 4 < length) break;
+      handle_request(client, client->in.data() + offset + 4, length);
+      offset += 4 + length;
+    }
+    client->in.erase(client->in.begin(), client->in.begin() + offset);
+  }
+
+  void handle_request(Client* client, const uint8_t* payload, uint32_t length) {
+    uint8_t type = payload[0];
+    const uint8_t* body = payload + 1;
+    uint32_t body_len = length - 1;
+    const std::vector<SomfyPoeMotor*>& motors = hub_->get_motors();
+
+    switch (type) {
+      case SOMFY_POE_CONTROL_LIST: {
+        if (body_len != 4) break;
+        size_t at = begin_frame(client, type | SOMFY_POE_CONTROL_REPLY);
+        uint32_t first;
+        uint32_t count = append_page(client, body, motors.size(), SOMFY_POE_CONTROL_LIST_PAGE, &first);
+        for (uint32_t i = first; i < first + count; i++) {
+          char ip[16] = {};
+          strncpy(ip, motors[i]->get_motor_ip(), sizeof(ip) - 1);
+          append(client, ip, sizeof(ip));
+        }
+        end_frame(client, at);
+        return;
+      }
+
+      case SOMFY_POE_CONTROL_MOVE: {
+        uint32_t count = 0;
+        if (body_len >= 4) memcpy(&count, body, 4);
+        if (body_len < 4 || body_len != 4 + (size_t) count * sizeof(SomfyPoeControlMove)) break;
+        size_t at = begin_frame(client, type | SOMFY_POE_CONTROL_REPLY);
+        append_u32(client, count);
+        apply_moves(client, reinterpret_cast<const SomfyPoeControlMove*>(body + 4), count, motors);
+        end_frame(client, at);
+        return;
+      }
+
+      case SOMFY_POE_CONTROL_SNAPSHOT: {
+        if (body_len != 4) break;
+        size_t at = begin_frame(client, type | SOMFY_POE_CONTROL_REPLY);
+        uint32_t first;
+        uint32_t count = append_page(client, body, motors.size(), SOMFY_POE_CONTROL_SNAPSHOT_PAGE, &first);
+        for (uint32_t i = first; i < first + count; i++) {
+          SomfyPoeControlState state = somfy_poe_control_state(motors[i]);
+          append(client, &state, sizeof(state));
+        }
+        end_frame(client, at);
+        return;
+      }
+
+      case SOMFY_POE_CONTROL_SUBSCRIBE: {
+        if (body_len != 1) break;
+        bool subscribing = body[0] != 0 && !client->subscribed;
+        client->subscribed = body[0] != 0;
+        end_frame(client, begin_frame(client, type | SOMFY_POE_CONTROL_REPLY));
+        // A new subscriber first receives every motor's current state
+        if (subscribing) {
+          for (size_t i = 0; i < motors.size(); i++) {
+            append_change(client, i, somfy_poe_control_state(motors[i]));
+          }
+        }
+        return;
+      }
+    }
+
+    size_t at = begin_frame(client, SOMFY_POE_CONTROL_ERROR);
+    uint8_t request_type = type;
+    append(client, &request_type, 1);
+    end_frame(client, at);
+  }
+
+  // Moves to a position go out together as one scene, so the hub can use
+  // group commands; the other actions are sent per motor. Each move gets
+  // its own result.
+  void apply_moves(Client* client, const SomfyPoeControlMove* moves, uint32_t count,
+                   const std::vector<SomfyPoeMotor*>& motors) {
+    scene_.clear();
+    for (uint32_t i = 0; i < count; i++) {
+      SomfyPoeControlMove move;
+      memcpy(&move, &moves[i], sizeof(move));
+      if (move.action == SOMFY_POE_ACTION_TO && move.force == 0 && move.motor < motors.size()) {
+        scene_.push_back({motors[move.motor], move.position});
+      }
+    }
+    if (!scene_.empty()) hub_->apply_scene(scene_, false, &scene_accepted_);
+
+    size_t scene_index = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      SomfyPoeControlMove move;
+      memcpy(&move, &moves[i], sizeof(move));
+      uint8_t accepted = 0;
+      if (move.motor < motors.size()) {
+        SomfyPoeMotor* motor = motors[move.motor];
+        switch (move.action) {
+          case SOMFY_POE_ACTION_TO:
+            accepted = move.force ? motor->move_to_position(move.position, true) : scene_accepted_[scene_index++];
+            break;
+          case SOMFY_POE_ACTION_UP:
+            accepted = motor->move_up(move.force != 0);
+            break;
+          case SOMFY_POE_ACTION_DOWN:
+            accepted = motor->move_down(move.force != 0);
+            break;
+          case SOMFY_POE_ACTION_STOP:
+            accepted = motor->stop();
+            break;
+        }
+      }
+      append(client, &accepted, 1);
+    }
+  }
+
+  // Sends subscribers the motors that changed since the last pass. Bursts
+  // between two loop passes are coalesced into one CHANGE per motor.
+  void publish_changes() {
+    const std::vector<SomfyPoeMotor*>& motors = hub_->get_motors();
+    size_t known = published_.size();
+    published_.resize(motors.size());
+    changed_.take(motors.size(), [this, &motors, known](size_t i) {
+      SomfyPoeControlState state = somfy_poe_control_state(motors[i]);
+      if (i < known && state == published_[i]) return;
+      published_[i] = state;
+      for (Client& client : clients_) {
+        if (client.subscribed && !client.closed) append_change(&client, i, state);
+      }
+    });
+  }
+
+  static void append_change(Client* client, uint32_t index, const SomfyPoeControlState& state) {
+    size_t at = begin_frame(client, SOMFY_POE_CONTROL_CHANGE);
+    append_u32(client, index);
+    append(client, &state, sizeof(state));
+    end_frame(client, at);
+  }
+
+  void flush(Client* client) {
+    size_t sent = 0;
+    while (sent < client->out.size()) {
+      ssize_t n = send(client->fd, client->out.data() + sent, client->out.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) client->closed = true;
+        break;
+      }
+      sent += n;
+    }
+    client->out.erase(client->out.begin(), client->out.begin() + sent);
+
+    if (client->out.size() > MAX_PENDING_OUTPUT + hub_->get_motors().size() * CHANGE_FRAME_SIZE) {
+      ESP_LOGW("somfy_poe", "Control client not reading, disconnecting");
+      client->closed = true;
+    }
+  }
+
+  // Frames are built in place: the length is patched in by end_frame()
+  static size_t begin_frame(Client* client, uint8_t type) {
+    size_t at = client->out.size();
+    uint8_t header[5] = {0, 0, 0, 0, type};
+    append(client, header, sizeof(header));
+    return at;
+  }
+
+  static void end_frame(Client* client, size_t at) {
+    uint32_t length = client->out.size() - at - 4;
+    memcpy(client->out.data() + at, &length, 4);
+  }
+
+  static void append(Client* client, const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    client->out.insert(client->out.end(), bytes, bytes + len);
+  }
+
+  static void append_u32(Client* client, uint32_t value) {
+    append(client, &value, 4);
+  }
+
+  // Page header for a request starting at `body` (first:u32). Returns how
+  // many motors the page holds, at most `page`.
+  static uint32_t append_page(Client* client, const uint8_t* body, uint32_t total, uint32_t page,
+                              uint32_t* first) {
+    memcpy(first, body, 4);
+    uint32_t count = *first < total ? std::min(total - *first, page) : 0;
+    append_u32(client, *first);
+    append_u32(client, total);
+    append_u32(client, count);
+    return count;
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
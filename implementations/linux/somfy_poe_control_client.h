@@ -0,0 +1,266 @@
+/*
+ * Client for the daemon's binary control socket
+ *
+ * Blocking and single-threaded; see somfy_poe_control_protocol.h for the
+ * wire format.
+ *
+ *   SomfyPoeControlClient client;
+ *   client.connect("/run/somfy_poe.sock");
+ *   client.move_to(0, 40.0f);
+ *
+ *   client.subscribe([](uint32_t motor, const SomfyPoeControlState& state) { ... });
+ *   while (client.wait_for_changes(1000)) {}
+ *
+ * Only the wire format is shared with the daemon, so tools using this
+ * need neither OpenSSL nor ArduinoJson.
+ */
+
+#pragma once
+
+#include "somfy_poe_control_protocol.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeControlClient {
+ public:
+  using ChangeCallback = std::function<void(uint32_t, const SomfyPoeControlState&)>;
+
+  ~SomfyPoeControlClient() {
+    disconnect();
+  }
+
+  bool connect(const char* path) {
+    disconnect();
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || ::connect(fd_, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  void disconnect() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+  // IP addresses, indexed as the daemon addresses its motors. Large
+  // fleets take one request per SOMFY_POE_CONTROL_LIST_PAGE motors.
+  bool list(std::vector<std::string>* ips) {
+    ips->clear();
+    uint32_t total = 0;
+    do {
+      uint32_t count;
+      if (!request_page(SOMFY_POE_CONTROL_LIST, ips->size(), 16, &total, &count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+        const char* ip = reinterpret_cast<const char*>(reply_.data() + SOMFY_POE_CONTROL_PAGE_HEADER + i * 16);
+        ips->emplace_back(ip, strnlen(ip, 16));
+      }
+    } while (ips->size() < total);
+    return true;
+  }
+
+  // Sends the moves in as few requests as fit in a frame (one scene each);
+  // accepted[i] reports moves[i]
+  bool move(const SomfyPoeControlMove* moves, uint32_t count, std::vector<uint8_t>* accepted = nullptr) {
+    if (accepted != nullptr) accepted->clear();
+    do {
+      uint32_t batch = std::min(count, SOMFY_POE_CONTROL_MAX_MOVES);
+      body_.resize(4 + batch * sizeof(SomfyPoeControlMove));
+      memcpy(body_.data(), &batch, 4);
+      memcpy(body_.data() + 4, moves, batch * sizeof(SomfyPoeControlMove));
+      if (!request(SOMFY_POE_CONTROL_MOVE, body_.data(), body_.size())) return false;
+
+      uint32_t replied;
+      if (!read_count(&replied, 5, 1) || replied != batch) return false;
+      if (accepted != nullptr) accepted->insert(accepted->end(), reply_.begin() + 5, reply_.begin() + 5 + batch);
+      moves += batch;
+      count -= batch;
+    } while (count > 0);
+    return true;
+  }
+
+  bool move(const std::vector<SomfyPoeControlMove>& moves, std::vector<uint8_t>* accepted = nullptr) {
+    return move(moves.data(), moves.size(), accepted);
+  }
+
+  // True if the daemon accepted the move
+  bool move_to(uint32_t motor, float position, bool force = false) {
+    SomfyPoeControlMove move_request = {};
+    move_request.motor = motor;
+    move_request.action = SOMFY_POE_ACTION_TO;
+    move_request.force = force;
+    move_request.position = position;
+    std::vector<uint8_t> accepted;
+    return move(&move_request, 1, &accepted) && accepted[0] != 0;
+  }
+
+  // Every motor's state. Large fleets take one request per
+  // SOMFY_POE_CONTROL_SNAPSHOT_PAGE motors, so pages may be a few loop
+  // passes apart.
+  bool snapshot(std::vector<SomfyPoeControlState>* states) {
+    states->clear();
+    uint32_t total = 0;
+    do {
+      uint32_t first = states->size();
+      uint32_t count;
+      if (!request_page(SOMFY_POE_CONTROL_SNAPSHOT, first, sizeof(SomfyPoeControlState), &total, &count)) {
+        return false;
+      }
+      states->resize(first + count);
+      memcpy(states->data() + first, reply_.data() + SOMFY_POE_CONTROL_PAGE_HEADER,
+             count * sizeof(SomfyPoeControlState));
+    } while (states->size() < total);
+    return true;
+  }
+
+  // Changes arrive through `callback`, both while waiting for replies and
+  // in wait_for_changes(). The daemon first reports every motor's state.
+  bool subscribe(ChangeCallback&& callback) {
+    on_change_ = std::move(callback);
+    uint8_t on = 1;
+    return request(SOMFY_POE_CONTROL_SUBSCRIBE, &on, 1);
+  }
+
+  bool unsubscribe() {
+    uint8_t off = 0;
+    bool ok = request(SOMFY_POE_CONTROL_SUBSCRIBE, &off, 1);
+    on_change_ = nullptr;
+    return ok;
+  }
+
+  // Waits up to timeout_ms for changes and dispatches them. Returns false
+  // if the connection was lost.
+  bool wait_for_changes(int timeout_ms) {
+    struct pollfd readable = {fd_, POLLIN, 0};
+    if (poll(&readable, 1, timeout_ms) <= 0) return fd_ >= 0;
+    do {
+      if (!read_frame()) return false;
+      if (reply_[0] == SOMFY_POE_CONTROL_CHANGE) dispatch_change();
+      readable.revents = 0;
+    } while (poll(&readable, 1, 0) > 0);
+    return true;
+  }
+
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  int fd_ = -1;
+  ChangeCallback on_change_;
+  std::vector<uint8_t> frame_;
+  std::vector<uint8_t> body_;
+  std::vector<uint8_t> reply_;  // Payload of the last frame read
+
+  // Sends a request and reads frames until its reply, dispatching changes
+  bool request(uint8_t type, const void* body, size_t body_len) {
+    if (fd_ < 0) return false;
+    uint32_t length = 1 + body_len;
+    frame_.resize(4 + length);
+    memcpy(frame_.data(), &length, 4);
+    frame_[4] = type;
+    if (body_len > 0) memcpy(frame_.data() + 5, body, body_len);
+    if (!write_all(frame_.data(), frame_.size())) return false;
+
+    while (read_frame()) {
+      if (reply_[0] == SOMFY_POE_CONTROL_CHANGE) {
+        dispatch_change();
+      } else {
+        return reply_[0] == (type | SOMFY_POE_CONTROL_REPLY);
+      }
+    }
+    return false;
+  }
+
+  // Requests the LIST or SNAPSHOT page from `first`. An empty page before
+  // the total is reached means the fleet shrank in between.
+  bool request_page(uint8_t type, uint32_t first, size_t item_size, uint32_t* total, uint32_t* count) {
+    if (!request(type, &first, 4)) return false;
+    uint32_t replied_first;
+    if (!read_count(count, SOMFY_POE_CONTROL_PAGE_HEADER, item_size)) return false;
+    memcpy(&replied_first, reply_.data() + 1, 4);
+    memcpy(total, reply_.data() + 5, 4);
+    return replied_first == first && (*count > 0 || first >= *total);
+  }
+
+  // Checks that the reply holds a u32 count just before `header` bytes end,
+  // followed by that many items
+  bool read_count(uint32_t* count, size_t header, size_t item_size) {
+    if (reply_.size() < header) return false;
+    memcpy(count, reply_.data() + header - 4, 4);
+    return reply_.size() == header + (size_t) *count * item_size;
+  }
+
+  void dispatch_change() {
+    if (!on_change_ || reply_.size() != 5 + sizeof(SomfyPoeControlState)) return;
+    uint32_t motor;
+    SomfyPoeControlState state;
+    memcpy(&motor, reply_.data() + 1, 4);
+    memcpy(&state, reply_.data() + 5, sizeof(state));
+    on_change_(motor, state);
+  }
+
+  bool read_frame() {
+    uint32_t length;
+    if (!read_all(&length, 4) || length == 0 || length > SOMFY_POE_CONTROL_MAX_FRAME) {
+      disconnect();
+      return false;
+    }
+    reply_.resize(length);
+    if (!read_all(reply_.data(), length)) {
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  bool read_all(void* out, size_t len) {
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    while (len > 0) {
+      ssize_t n = recv(fd_, bytes, len, 0);
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR) continue;
+        return false;
+      }
+      bytes += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool write_all(const uint8_t* data, size_t len) {
+    while (len > 0) {
+      ssize_t n = send(fd_, data, len, MSG_NOSIGNAL);
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR) continue;
+        disconnect();
+        return false;
+      }
+      data += n;
+      len -= n;
+    }
+    return true;
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,93 @@
+/*
+ * Wire format of the daemon's binary control socket
+ *
+ * Every message is a frame: a uint32 payload length, then the payload,
+ * which starts with a one-byte type. Integers and floats are in native byte
+ * order, since both ends run on the same machine.
+ *
+ *   Request                               Reply
+ *   LIST      first:u32                   LIST     Page, count x ip[16]
+ *   MOVE      count:u32, count x Move     MOVE     count:u32, count x accepted:u8
+ *   SNAPSHOT  first:u32                   SNAPSHOT Page, count x State
+ *   SUBSCRIBE on:u8                       SUBSCRIBE
+ *
+ *   Page = first:u32, total:u32, count:u32
+ *
+ * Replies carry the request's type with REPLY set and come in request order.
+ * Motors are addressed by their index in the hub (see LIST). A frame holds
+ * at most SOMFY_POE_CONTROL_MAX_FRAME bytes, so LIST and SNAPSHOT reply
+ * with the motors from `first` that fit (total is the number of motors);
+ * clients ask again from first + count for the rest. A subscribed client
+ * also receives CHANGE frames (motor:u32, State) between replies: one per
+ * motor right after the SUBSCRIBE reply, then whenever a motor's position,
+ * direction or health changes. A malformed request
+ * gets an ERROR frame (request type:u8).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace somfy_poe {
+
+enum SomfyPoeControlType : uint8_t {
+  SOMFY_POE_CONTROL_LIST = 0x01,
+  SOMFY_POE_CONTROL_MOVE = 0x02,
+  SOMFY_POE_CONTROL_SNAPSHOT = 0x03,
+  SOMFY_POE_CONTROL_SUBSCRIBE = 0x04,
+  SOMFY_POE_CONTROL_REPLY = 0x80,
+  SOMFY_POE_CONTROL_CHANGE = 0x90,
+  SOMFY_POE_CONTROL_ERROR = 0xFF,
+};
+
+enum SomfyPoeControlAction : uint8_t {
+  SOMFY_POE_ACTION_TO = 0,
+  SOMFY_POE_ACTION_UP = 1,
+  SOMFY_POE_ACTION_DOWN = 2,
+  SOMFY_POE_ACTION_STOP = 3,
+};
+
+struct __attribute__((packed)) SomfyPoeControlMove {
+  uint32_t motor;
+  uint8_t action;  // SomfyPoeControlAction
+  uint8_t force;   // Send even if the motor is already there
+  float position;  // For SOMFY_POE_ACTION_TO: 0 = open, 100 = closed
+  uint8_t reserved[2];
+};
+
+struct __attribute__((packed)) SomfyPoeControlState {
+  float position;     // Negative while unknown
+  uint8_t direction;  // 0 stopped, 1 up, 2 down
+  uint8_t health;     // SomfyPoeHealth
+  uint8_t flags;      // SOMFY_POE_STATE_*
+  uint8_t reserved;
+
+  bool operator==(const SomfyPoeControlState& other) const {
+    return position == other.position && direction == other.direction && health == other.health &&
+           flags == other.flags;
+  }
+};
+
+static_assert(sizeof(SomfyPoeControlMove) == 12, "SomfyPoeControlMove is part of the wire format");
+static_assert(sizeof(SomfyPoeControlState) == 8, "SomfyPoeControlState is part of the wire format");
+
+const uint8_t SOMFY_POE_STATE_AUTHENTICATED = 0x01;
+const uint8_t SOMFY_POE_STATE_STALE = 0x02;       // Position restored at boot, not yet reported
+const uint8_t SOMFY_POE_STATE_LOCKED = 0x04;      // See lock.get
+const uint8_t SOMFY_POE_STATE_LOCK_STALE = 0x08;  // Lock state restored at boot, not yet reported
+
+// Largest frame either side accepts
+const uint32_t SOMFY_POE_CONTROL_MAX_FRAME = 65536;
+
+// Type and Page ahead of a LIST or SNAPSHOT page's entries
+const uint32_t SOMFY_POE_CONTROL_PAGE_HEADER = 13;
+
+// Most entries in one page or request
+const uint32_t SOMFY_POE_CONTROL_LIST_PAGE = (SOMFY_POE_CONTROL_MAX_FRAME - SOMFY_POE_CONTROL_PAGE_HEADER) / 16;
+const uint32_t SOMFY_POE_CONTROL_SNAPSHOT_PAGE =
+    (SOMFY_POE_CONTROL_MAX_FRAME - SOMFY_POE_CONTROL_PAGE_HEADER) / sizeof(SomfyPoeControlState);
+const uint32_t SOMFY_POE_CONTROL_MAX_MOVES = (SOMFY_POE_CONTROL_MAX_FRAME - 5) / sizeof(SomfyPoeControlMove);
+
+}  // namespace somfy_poe
+}  // namespace esphome
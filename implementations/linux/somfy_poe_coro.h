@@ -0,0 +1,427 @@
+/*
+ * C++20 coroutine API for the Linux build
+ *
+ * Awaitable wrappers around the motor and hub, so a sequence of commands
+ * reads top to bottom instead of as nested callbacks:
+ *
+ *   SomfyPoeTask<bool> close_then_vent(SomfyPoeMotor& motor) {
+ *     if (!co_await async_move_to(motor, 100.0f)) co_return false;
+ *     co_return co_await async_move_to(motor, 80.0f);
+ *   }
+ *
+ *   SomfyPoeEventLoop::instance().run(close_then_vent(motor));
+ *
+ * Everything runs on the program's single thread. An awaited move resumes
+ * on the loop pass after its reply (or timeout) was processed, never from
+ * inside the motor's packet handling, so a coroutine may issue the next
+ * command straight away. Coroutine frames come from a fixed pool, so
+ * steady-state operation does not allocate.
+ *
+ * Motors awaited through this API must live until the program exits.
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Frame slots in the coroutine frame pool, and the size of each. A frame
+// holds the coroutine's locals and awaiters; larger frames and frames
+// beyond the pool fall back to the heap (see get_fallback_count()).
+#ifndef SOMFY_POE_CORO_FRAMES
+#define SOMFY_POE_CORO_FRAMES 256
+#endif
+#ifndef SOMFY_POE_CORO_FRAME_SIZE
+#define SOMFY_POE_CORO_FRAME_SIZE 512
+#endif
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeFramePool {
+ public:
+  static SomfyPoeFramePool& instance() {
+    static SomfyPoeFramePool pool;
+    return pool;
+  }
+
+  void* allocate(size_t size) {
+    if (size <= SOMFY_POE_CORO_FRAME_SIZE && free_ != nullptr) {
+      Frame* frame = free_;
+      free_ = frame->next;
+      in_use_++;
+      if (in_use_ > high_water_) high_water_ = in_use_;
+      return frame;
+    }
+    fallbacks_++;
+    return ::operator new(size);
+  }
+
+  void release(void* frame) {
+    if (frame < (void*) arena_ || frame >= (void*) (arena_ + SOMFY_POE_CORO_FRAMES)) {
+      ::operator delete(frame);
+      return;
+    }
+    Frame* slot = static_cast<Frame*>(frame);
+    slot->next = free_;
+    free_ = slot;
+    in_use_--;
+  }
+
+  size_t get_in_use() const {
+    return in_use_;
+  }
+
+  size_t get_high_water() const {
+    return high_water_;
+  }
+
+  // Frames that had to come from the heap
+  uint32_t get_fallback_count() const {
+    return fallbacks_;
+  }
+
+ private:
+  union Frame {
+    Frame* next;
+    alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) unsigned char bytes[SOMFY_POE_CORO_FRAME_SIZE];
+  };
+
+  SomfyPoeFramePool() {
+    for (size_t i = SOMFY_POE_CORO_FRAMES; i-- > 0;) {
+      arena_[i].next = free_;
+      free_ = &arena_[i];
+    }
+  }
+
+  Frame arena_[SOMFY_POE_CORO_FRAMES];
+  Frame* free_ = nullptr;
+  size_t in_use_ = 0;
+  size_t high_water_ = 0;
+  uint32_t fallbacks_ = 0;
+};
+
+// Runs App.loop() and resumes coroutines whose operation has completed
+class SomfyPoeEventLoop {
+ public:
+  static SomfyPoeEventLoop& instance() {
+    static SomfyPoeEventLoop loop;
+    return loop;
+  }
+
+  // Queues a suspended coroutine to be resumed on this loop pass
+  void post(std::coroutine_handle<> handle) {
+    ready_.push_back(handle);
+  }
+
+  void resume_ready() {
+    // Coroutines resumed here may queue others for the next round
+    while (!ready_.empty()) {
+      std::swap(ready_, running_);
+      for (std::coroutine_handle<> handle : running_) handle.resume();
+      running_.clear();
+    }
+  }
+
+  // One pass: components first, then the coroutines they completed
+  void poll() {
+    App.loop();
+    resume_ready();
+  }
+
+  // Starts `task` and drives the loop until it finishes
+  template <typename Task> auto run(Task&& task) {
+    task.start();
+    while (!task.done()) {
+      poll();
+      if (!task.done()) delay(1);
+    }
+    return task.result();
+  }
+
+ private:
+  std::vector<std::coroutine_handle<>> ready_;
+  std::vector<std::coroutine_handle<>> running_;
+};
+
+// A lazily started coroutine returning T. Awaiting it from another
+// coroutine runs it and resumes the awaiter when it returns; a top-level
+// task is started with start() or SomfyPoeEventLoop::run().
+template <typename T> class SomfyPoeTask {
+ public:
+  struct promise_type {
+    T value{};
+    std::coroutine_handle<> continuation;
+
+    SomfyPoeTask get_return_object() {
+      return SomfyPoeTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    // Hands control straight back to the awaiting coroutine, if any
+    auto final_suspend() noexcept {
+      struct FinalAwaiter {
+        bool await_ready() noexcept {
+          return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+          std::coroutine_handle<> continuation = handle.promise().continuation;
+          return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+
+    void return_value(T result) {
+      value = std::move(result);
+    }
+
+    // The protocol code does not throw
+    void unhandled_exception() {
+      std::terminate();
+    }
+
+    static void* operator new(size_t size) {
+      return SomfyPoeFramePool::instance().allocate(size);
+    }
+
+    static void operator delete(void* frame) {
+      SomfyPoeFramePool::instance().release(frame);
+    }
+  };
+
+  explicit SomfyPoeTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+  SomfyPoeTask(SomfyPoeTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+  SomfyPoeTask(const SomfyPoeTask&) = delete;
+  SomfyPoeTask& operator=(const SomfyPoeTask&) = delete;
+
+  ~SomfyPoeTask() {
+    if (handle_) handle_.destroy();
+  }
+
+  void start() {
+    if (handle_ && !handle_.done()) handle_.resume();
+  }
+
+  bool done() const {
+    return !handle_ || handle_.done();
+  }
+
+  T result() const {
+    return handle_.promise().value;
+  }
+
+  bool await_ready() const {
+    return done();
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+
+  T await_resume() {
+    return handle_.promise().value;
+  }
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Counts down outstanding move results and resumes the waiting coroutine
+// once all are in. ok is true only if every move succeeded.
+struct SomfyPoeJoin {
+  size_t remaining = 0;
+  bool ok = true;
+  std::coroutine_handle<> waiting;
+
+  void complete(bool result) {
+    ok = ok && result;
+    if (--remaining == 0 && waiting) SomfyPoeEventLoop::instance().post(waiting);
+  }
+};
+
+// Coroutines waiting on move results from one motor. The waiters live in
+// the awaiting coroutines' frames and are linked through them.
+class SomfyPoeMoveWaiters {
+ public:
+  struct Waiter {
+    uint32_t seq = 0;
+    SomfyPoeJoin* join = nullptr;
+    Waiter* next = nullptr;
+  };
+
+  // The waiter list of `motor`, subscribed to its results on first use
+  static SomfyPoeMoveWaiters& of(SomfyPoeMotor* motor) {
+    static std::map<SomfyPoeMotor*, SomfyPoeMoveWaiters> all;
+    auto it = all.find(motor);
+    if (it == all.end()) {
+      it = all.emplace(motor, SomfyPoeMoveWaiters()).first;
+      SomfyPoeMoveWaiters* waiters = &it->second;
+      motor->add_on_move_result_callback([waiters](uint32_t seq, bool ok) { waiters->on_result(seq, ok); });
+    }
+    return it->second;
+  }
+
+  void add(Waiter* waiter) {
+    waiter->next = head_;
+    head_ = waiter;
+  }
+
+  // A result for `seq` also settles waiters on older moves it superseded
+  void on_result(uint32_t seq, bool ok) {
+    Waiter** link = &head_;
+    while (*link != nullptr) {
+      Waiter* waiter = *link;
+      if ((int32_t) (seq - waiter->seq) >= 0) {
+        *link = waiter->next;
+        waiter->join->complete(ok);
+      } else {
+        link = &waiter->next;
+      }
+    }
+  }
+
+ private:
+  Waiter* head_ = nullptr;
+};
+
+// Registers `waiter` for the move just submitted to `motor`, given the
+// move sequence number before submitting. Returns false if there is
+// nothing to wait for: the move was elided or went out as a group command.
+inline bool somfy_poe_watch_move(SomfyPoeMotor* motor, uint32_t seq_before, SomfyPoeJoin* join,
+                                 SomfyPoeMoveWaiters::Waiter* waiter) {
+  uint32_t seq = motor->get_move_seq();
+  if (seq != seq_before) {
+    if (!motor->is_awaiting_move(seq)) return false;
+    waiter->seq = seq;
+  } else if (motor->has_deferred_move()) {
+    waiter->seq = seq_before + 1;
+  } else {
+    return false;
+  }
+  waiter->join = join;
+  join->remaining++;
+  SomfyPoeMoveWaiters::of(motor).add(waiter);
+  return true;
+}
+
+// Waits for the result of move `seq` reported to `waiters`
+class SomfyPoeMoveResultAwaiter {
+ public:
+  SomfyPoeMoveResultAwaiter(SomfyPoeMoveWaiters& waiters, uint32_t seq) : waiters_(&waiters) {
+    waiter_.seq = seq;
+  }
+
+  bool await_ready() {
+    waiter_.join = &join_;
+    join_.remaining = 1;
+    waiters_->add(&waiter_);
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    join_.waiting = handle;
+    return join_.remaining > 0;
+  }
+
+  bool await_resume() const {
+    return join_.ok;
+  }
+
+ private:
+  SomfyPoeMoveWaiters* waiters_;
+  SomfyPoeMoveWaiters::Waiter waiter_;
+  SomfyPoeJoin join_;
+};
+
+// co_await async_move_to(motor, position): true once the motor confirms
+// the move, false if it was rejected, failed or timed out. A move that is
+// already at its target (see set_position_tolerance()) completes at once.
+class SomfyPoeMoveAwaiter {
+ public:
+  SomfyPoeMoveAwaiter(SomfyPoeMotor& motor, float position, bool force)
+    : motor_(&motor), position_(position), force_(force) {}
+
+  bool await_ready() {
+    uint32_t seq_before = motor_->get_move_seq();
+    if (!motor_->move_to_position(position_, force_)) {
+      join_.ok = false;
+      return true;
+    }
+    return !somfy_poe_watch_move(motor_, seq_before, &join_, &waiter_);
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    join_.waiting = handle;
+    return join_.remaining > 0;
+  }
+
+  bool await_resume() const {
+    return join_.ok;
+  }
+
+ private:
+  SomfyPoeMotor* motor_;
+  float position_;
+  bool force_;
+  SomfyPoeMoveWaiters::Waiter waiter_;
+  SomfyPoeJoin join_;
+};
+
+// co_await async_scene(hub, targets): applies the scene and completes when
+// every unicast move has its result. Moves sent as group commands have no
+// reply and count as done once sent. True if every move succeeded.
+class SomfyPoeSceneAwaiter {
+ public:
+  SomfyPoeSceneAwaiter(SomfyPoeHub& hub, std::vector<SomfyPoeSceneTarget> targets)
+    : hub_(&hub), targets_(std::move(targets)), waiters_(targets_.size()) {}
+
+  bool await_ready() {
+    std::vector<uint32_t> seq_before;
+    seq_before.reserve(targets_.size());
+    for (const SomfyPoeSceneTarget& target : targets_) seq_before.push_back(target.motor->get_move_seq());
+
+    join_.ok = hub_->apply_scene(targets_);
+    for (size_t i = 0; i < targets_.size(); i++) {
+      somfy_poe_watch_move(targets_[i].motor, seq_before[i], &join_, &waiters_[i]);
+    }
+    return join_.remaining == 0;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    join_.waiting = handle;
+    return join_.remaining > 0;
+  }
+
+  bool await_resume() const {
+    return join_.ok;
+  }
+
+ private:
+  SomfyPoeHub* hub_;
+  std::vector<SomfyPoeSceneTarget> targets_;
+  std::vector<SomfyPoeMoveWaiters::Waiter> waiters_;
+  SomfyPoeJoin join_;
+};
+
+inline SomfyPoeMoveAwaiter async_move_to(SomfyPoeMotor& motor, float position, bool force = false) {
+  return SomfyPoeMoveAwaiter(motor, position, force);
+}
+
+inline SomfyPoeSceneAwaiter async_scene(SomfyPoeHub& hub, std::vector<SomfyPoeSceneTarget> targets) {
+  return SomfyPoeSceneAwaiter(hub, std::move(targets));
+}
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,181 @@
+/*
+ * Read-only view of a binary fleet database (somfy_poe_fleet_db_layout.h)
+ *
+ *   SomfyPoeFleetDb fleet;
+ *   fleet.open("/etc/somfy_poe/fleet.db");
+ *   const SomfyPoeFleetRecord* motor = fleet.find_by_ip("192.168.1.150");
+ *
+ * The file is mapped, not read: open() checks only the header, and records
+ * are paged in as they are used. Lookups by IP and targetID are binary
+ * searches over the indexes. Record strings stay valid until close(), so
+ * motors may point straight at them.
+ */
+
+#pragma once
+
+#include "somfy_poe_fleet_db_layout.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeFleetDb {
+ public:
+  ~SomfyPoeFleetDb() {
+    close();
+  }
+
+  bool open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SomfyPoeFleetHeader)) {
+      ::close(fd);
+      return false;
+    }
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    header_ = static_cast<const SomfyPoeFleetHeader*>(map);
+    size_ = info.st_size;
+    if (!check_header()) {
+      close();
+      return false;
+    }
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    records_ = reinterpret_cast<const SomfyPoeFleetRecord*>(base + header_->records_offset);
+    ip_index_ = reinterpret_cast<const SomfyPoeFleetIpEntry*>(base + header_->ip_index_offset);
+    target_index_ = reinterpret_cast<const uint32_t*>(base + header_->target_index_offset);
+    strings_ = reinterpret_cast<const char*>(base + header_->strings_offset);
+    return true;
+  }
+
+  void close() {
+    if (header_ != nullptr) munmap(const_cast<SomfyPoeFleetHeader*>(header_), size_);
+    header_ = nullptr;
+    records_ = nullptr;
+  }
+
+  bool is_open() const {
+    return header_ != nullptr;
+  }
+
+  uint32_t get_count() const {
+    return header_ != nullptr ? header_->count : 0;
+  }
+
+  uint32_t get_session_count() const {
+    return header_ != nullptr ? header_->session_count : 0;
+  }
+
+  // Record `index`, or nullptr if out of range or its strings are not
+  // terminated (a damaged file)
+  const SomfyPoeFleetRecord* get_record(uint32_t index) const {
+    if (index >= get_count()) return nullptr;
+    const SomfyPoeFleetRecord* record = &records_[index];
+    if (record->ip[sizeof(record->ip) - 1] != '\0' || record->pin[sizeof(record->pin) - 1] != '\0' ||
+        record->target_id[sizeof(record->target_id) - 1] != '\0') {
+      return nullptr;
+    }
+    return record;
+  }
+
+  uint32_t index_of(const SomfyPoeFleetRecord* record) const {
+    return record - records_;
+  }
+
+  const SomfyPoeFleetRecord* find_by_ip(const char* ip) const {
+    struct in_addr parsed;
+    if (header_ == nullptr || inet_pton(AF_INET, ip, &parsed) != 1) return nullptr;
+    uint32_t address = ntohl(parsed.s_addr);
+
+    uint32_t low = 0;
+    uint32_t high = header_->count;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      if (ip_index_[mid].address < address) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == header_->count || ip_index_[low].address != address) return nullptr;
+    return get_record(ip_index_[low].record);
+  }
+
+  const SomfyPoeFleetRecord* find_by_target_id(const char* target_id) const {
+    if (header_ == nullptr) return nullptr;
+    uint32_t low = 0;
+    uint32_t high = header_->session_count;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      const SomfyPoeFleetRecord* record = get_record(target_index_[mid]);
+      if (record == nullptr) return nullptr;
+      if (strcmp(record->target_id, target_id) < 0) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == header_->session_count) return nullptr;
+    const SomfyPoeFleetRecord* record = get_record(target_index_[low]);
+    return record != nullptr && strcmp(record->target_id, target_id) == 0 ? record : nullptr;
+  }
+
+  // Appends the record's group names to `groups`. False if the string
+  // table does not hold them all.
+  bool get_groups(const SomfyPoeFleetRecord* record, std::vector<std::string>* groups) const {
+    uint32_t offset = record->groups_offset;
+    for (uint16_t i = 0; i < record->group_count; i++) {
+      if (offset >= header_->strings_size) return false;
+      const char* name = strings_ + offset;  // The table ends with a NUL
+      groups->emplace_back(name);
+      offset += strlen(name) + 1;
+    }
+    return true;
+  }
+
+ private:
+  const SomfyPoeFleetHeader* header_ = nullptr;
+  size_t size_ = 0;
+  const SomfyPoeFleetRecord* records_ = nullptr;
+  const SomfyPoeFleetIpEntry* ip_index_ = nullptr;
+  const uint32_t* target_index_ = nullptr;
+  const char* strings_ = nullptr;
+
+  // Only this exact layout is understood, and every section must lie
+  // within the file
+  bool check_header() const {
+    const SomfyPoeFleetHeader& h = *header_;
+    if (h.magic != SOMFY_POE_FLEET_MAGIC || h.version != SOMFY_POE_FLEET_VERSION ||
+        h.header_size != sizeof(SomfyPoeFleetHeader) || h.record_size != sizeof(SomfyPoeFleetRecord) ||
+        h.file_size != size_ || h.session_count > h.count) {
+      return false;
+    }
+    if (!section_fits(h.records_offset, (uint64_t) h.count * sizeof(SomfyPoeFleetRecord)) ||
+        !section_fits(h.ip_index_offset, (uint64_t) h.count * sizeof(SomfyPoeFleetIpEntry)) ||
+        !section_fits(h.target_index_offset, (uint64_t) h.session_count * sizeof(uint32_t)) ||
+        !section_fits(h.strings_offset, h.strings_size)) {
+      return false;
+    }
+    const char* strings = reinterpret_cast<const char*>(header_) + h.strings_offset;
+    return h.strings_size == 0 || strings[h.strings_size - 1] == '\0';
+  }
+
+  bool section_fits(uint32_t offset, uint64_t length) const {
+    return offset % 8 == 0 && offset >= sizeof(SomfyPoeFleetHeader) && offset + length <= size_;
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
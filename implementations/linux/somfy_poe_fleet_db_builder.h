@@ -0,0 +1,265 @@
+/*
+ * Compiles a fleet database (somfy_poe_fleet_db_layout.h)
+ *
+ * From a text config, one motor per line:
+ *
+ *   # ip           pin   [groups=a,b] [target=ID key=32 hex digits]
+ *   192.168.1.150  1234  groups=living,south
+ *   192.168.1.151  5678  target=4a2b8c6d key=000102030405060708090a0b0c0d0e0f
+ *
+ *   SomfyPoeFleetDbBuilder builder;
+ *   builder.load_config("fleet.conf") && builder.write("fleet.db");
+ *
+ * or from entries added directly, as the daemon does when it saves
+ * sessions. write() replaces the file atomically, so a daemon still mapping
+ * the old one is unaffected.
+ */
+
+#pragma once
+
+#include "somfy_poe_fleet_db.h"
+#include "somfy_poe_hub.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace esphome {
+namespace somfy_poe {
+
+struct SomfyPoeFleetEntry {
+  std::string ip;
+  std::string pin;
+  std::vector<std::string> groups;
+  bool has_session = false;
+  std::string target_id;
+  uint8_t key[16] = {};
+};
+
+class SomfyPoeFleetDbBuilder {
+ public:
+  bool add(const SomfyPoeFleetEntry& entry) {
+    struct in_addr parsed;
+    if (inet_pton(AF_INET, entry.ip.c_str(), &parsed) != 1) {
+      ESP_LOGE("somfy_poe", "Invalid motor address '%s'", entry.ip.c_str());
+      return false;
+    }
+    if (entry.pin.empty() || entry.pin.size() >= sizeof(SomfyPoeFleetRecord::pin)) {
+      ESP_LOGE("somfy_poe", "%s: PIN must be 1 to %u characters", entry.ip.c_str(),
+               (unsigned) sizeof(SomfyPoeFleetRecord::pin) - 1);
+      return false;
+    }
+    if (entry.has_session &&
+        (entry.target_id.empty() || entry.target_id.size() >= sizeof(SomfyPoeFleetRecord::target_id))) {
+      ESP_LOGE("somfy_poe", "%s: targetID must be 1 to %u characters", entry.ip.c_str(),
+               (unsigned) sizeof(SomfyPoeFleetRecord::target_id) - 1);
+      return false;
+    }
+    for (const std::string& group : entry.groups) {
+      if (group.empty() || group.find('\0') != std::string::npos) {
+        ESP_LOGE("somfy_poe", "%s: invalid group name", entry.ip.c_str());
+        return false;
+      }
+    }
+    entries_.push_back(entry);
+    return true;
+  }
+
+  size_t get_count() const {
+    return entries_.size();
+  }
+
+  // Adds every motor in a text config. Stops at the first bad line.
+  bool load_config(const char* path) {
+    std::ifstream config(path);
+    if (!config) {
+      ESP_LOGE("somfy_poe", "Cannot read %s", path);
+      return false;
+    }
+    std::string line;
+    for (unsigned number = 1; std::getline(config, line); number++) {
+      SomfyPoeFleetEntry entry;
+      if (!parse_line(line, &entry)) {
+        ESP_LOGE("somfy_poe", "%s:%u: expected 'ip pin [groups=a,b] [target=ID key=HEX]'", path, number);
+        return false;
+      }
+      if (entry.ip.empty()) continue;  // Blank or comment
+      if (!add(entry)) {
+        ESP_LOGE("somfy_poe", "%s:%u: invalid motor", path, number);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Leaves entry->ip empty for blank lines and comments
+  static bool parse_line(const std::string& line, SomfyPoeFleetEntry* entry) {
+    std::istringstream words(line.substr(0, line.find('#')));
+    if (!(words >> entry->ip)) return true;
+    if (!(words >> entry->pin)) return false;
+
+    bool has_target = false;
+    bool has_key = false;
+    std::string word;
+    while (words >> word) {
+      if (word.compare(0, 7, "groups=") == 0) {
+        std::istringstream names(word.substr(7));
+        std::string name;
+        while (std::getline(names, name, ',')) {
+          if (!name.empty()) entry->groups.push_back(name);
+        }
+      } else if (word.compare(0, 7, "target=") == 0) {
+        entry->target_id = word.substr(7);
+        has_target = true;
+      } else if (word.compare(0, 4, "key=") == 0) {
+        if (!parse_key(word.substr(4), entry->key)) return false;
+        has_key = true;
+      } else {
+        return false;
+      }
+    }
+    // A session needs both halves
+    if (has_target != has_key) return false;
+    entry->has_session = has_target;
+    return true;
+  }
+
+  // The config line for `entry`, as parse_line() reads it
+  static std::string format_line(const SomfyPoeFleetEntry& entry) {
+    std::string line = entry.ip + " " + entry.pin;
+    for (size_t i = 0; i < entry.groups.size(); i++) {
+      line += (i == 0 ? " groups=" : ",") + entry.groups[i];
+    }
+    if (entry.has_session) {
+      char hex[33];
+      for (int i = 0; i < 16; i++) snprintf(hex + i * 2, 3, "%02x", entry.key[i]);
+      line += " target=" + entry.target_id + " key=" + hex;
+    }
+    return line;
+  }
+
+  // A database record as an entry, e.g. to compile it again with a new
+  // session
+  static SomfyPoeFleetEntry entry_of(const SomfyPoeFleetDb& db, const SomfyPoeFleetRecord* record) {
+    SomfyPoeFleetEntry entry;
+    entry.ip = record->ip;
+    entry.pin = record->pin;
+    db.get_groups(record, &entry.groups);
+    if (record->flags & SOMFY_POE_FLEET_HAS_SESSION) {
+      entry.has_session = true;
+      entry.target_id = record->target_id;
+      memcpy(entry.key, record->key, sizeof(entry.key));
+    }
+    return entry;
+  }
+
+  // Rejects duplicate IPs or targetIDs. Writes to a temporary file first
+  // and renames it over `path`.
+  bool write(const char* path) const {
+    std::vector<uint8_t> image;
+    if (!build(&image)) return false;
+
+    std::string temporary = std::string(path) + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      ESP_LOGE("somfy_poe", "Cannot create %s", temporary.c_str());
+      return false;
+    }
+    bool ok = ::write(fd, image.data(), image.size()) == (ssize_t) image.size() && fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path) != 0) {
+      ESP_LOGE("somfy_poe", "Cannot write %s", path);
+      unlink(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  std::vector<SomfyPoeFleetEntry> entries_;
+
+  static bool parse_key(const std::string& hex, uint8_t* key) {
+    if (hex.size() != 32 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) return false;
+    for (int i = 0; i < 16; i++) key[i] = strtoul(hex.substr(i * 2, 2).c_str(), nullptr, 16);
+    return true;
+  }
+
+  static uint32_t align(size_t offset) {
+    return (offset + 7) & ~(size_t) 7;
+  }
+
+  bool build(std::vector<uint8_t>* image) const {
+    uint32_t count = entries_.size();
+    std::vector<SomfyPoeFleetRecord> records(count);
+    std::vector<SomfyPoeFleetIpEntry> ip_index(count);
+    std::vector<uint32_t> target_index;
+    std::string strings;
+
+    for (uint32_t i = 0; i < count; i++) {
+      const SomfyPoeFleetEntry& entry = entries_[i];
+      SomfyPoeFleetRecord& record = records[i];
+      memset(&record, 0, sizeof(record));
+      strncpy(record.ip, entry.ip.c_str(), sizeof(record.ip) - 1);
+      strncpy(record.pin, entry.pin.c_str(), sizeof(record.pin) - 1);
+      record.groups_offset = strings.size();
+      record.group_count = entry.groups.size();
+      for (const std::string& group : entry.groups) strings.append(group.c_str(), group.size() + 1);
+      if (entry.has_session) {
+        strncpy(record.target_id, entry.target_id.c_str(), sizeof(record.target_id) - 1);
+        memcpy(record.key, entry.key, sizeof(record.key));
+        record.flags |= SOMFY_POE_FLEET_HAS_SESSION;
+        target_index.push_back(i);
+      }
+
+      struct in_addr parsed;
+      inet_pton(AF_INET, record.ip, &parsed);
+      ip_index[i] = {ntohl(parsed.s_addr), i};
+    }
+
+    std::sort(ip_index.begin(), ip_index.end(), [](const SomfyPoeFleetIpEntry& a, const SomfyPoeFleetIpEntry& b) {
+      return a.address < b.address;
+    });
+    for (uint32_t i = 1; i < count; i++) {
+      if (ip_index[i].address == ip_index[i - 1].address) {
+        ESP_LOGE("somfy_poe", "Motor %s listed twice", records[ip_index[i].record].ip);
+        return false;
+      }
+    }
+    std::sort(target_index.begin(), target_index.end(), [&records](uint32_t a, uint32_t b) {
+      return strcmp(records[a].target_id, records[b].target_id) < 0;
+    });
+    for (size_t i = 1; i < target_index.size(); i++) {
+      if (strcmp(records[target_index[i]].target_id, records[target_index[i - 1]].target_id) == 0) {
+        ESP_LOGE("somfy_poe", "targetID %s listed twice", records[target_index[i]].target_id);
+        return false;
+      }
+    }
+
+    SomfyPoeFleetHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SOMFY_POE_FLEET_MAGIC;
+    header.version = SOMFY_POE_FLEET_VERSION;
+    header.header_size = sizeof(SomfyPoeFleetHeader);
+    header.record_size = sizeof(SomfyPoeFleetRecord);
+    header.count = count;
+    header.session_count = target_index.size();
+    header.records_offset = sizeof(SomfyPoeFleetHeader);
+    header.ip_index_offset = align(header.records_offset + records.size() * sizeof(SomfyPoeFleetRecord));
+    header.target_index_offset = align(header.ip_index_offset + ip_index.size() * sizeof(SomfyPoeFleetIpEntry));
+    header.strings_offset = align(header.target_index_offset + target_index.size() * sizeof(uint32_t));
+    header.strings_size = strings.size();
+    header.file_size = header.strings_offset + header.strings_size;
+
+    image->assign(header.file_size, 0);
+    memcpy(image->data(), &header, sizeof(header));
+    memcpy(image->data() + header.records_offset, records.data(), records.size() * sizeof(SomfyPoeFleetRecord));
+    memcpy(image->data() + header.ip_index_offset, ip_index.data(), ip_index.size() * sizeof(SomfyPoeFleetIpEntry));
+    memcpy(image->data() + header.target_index_offset, target_index.data(), target_index.size() * sizeof(uint32_t));
+    memcpy(image->data() + header.strings_offset, strings.data(), strings.size());
+    return true;
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
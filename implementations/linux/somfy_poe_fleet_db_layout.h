@@ -0,0 +1,71 @@
+/*
+ * File layout of the binary fleet database
+ *
+ * The daemon maps the file read-only at startup instead of parsing a text
+ * config, so opening it costs the same for ten motors or ten thousand:
+ *
+ *   header        magic "SPFD", version, header/record sizes, counts and the
+ *                 offset of each section below
+ *   records       64 bytes per motor: ip, pin, cached targetID and AES key,
+ *                 and its group names in the string table
+ *   ip index      (IPv4 address, record) pairs sorted by address
+ *   target index  record numbers sorted by targetID, motors without a
+ *                 cached session left out
+ *   strings       group names, each NUL-terminated
+ *
+ * Sections start at multiples of 8 bytes. All fields are native-endian; the
+ * database is compiled on the host that uses it (somfy_poe_db).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace somfy_poe {
+
+static const uint32_t SOMFY_POE_FLEET_MAGIC = 0x44465053;  // "SPFD"
+static const uint16_t SOMFY_POE_FLEET_VERSION = 1;
+
+// Record has a cached session (target_id and key)
+static const uint8_t SOMFY_POE_FLEET_HAS_SESSION = 0x01;
+
+struct SomfyPoeFleetHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size;
+  uint16_t record_size;
+  uint16_t reserved;
+  uint32_t count;
+  uint32_t session_count;  // Entries in the target index
+  uint32_t records_offset;
+  uint32_t ip_index_offset;
+  uint32_t target_index_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+  uint32_t file_size;
+  uint8_t padding[20];
+};
+
+struct SomfyPoeFleetRecord {
+  char ip[16];
+  char pin[8];
+  char target_id[16];
+  uint8_t key[16];
+  uint32_t groups_offset;  // First group name in the string table
+  uint16_t group_count;
+  uint8_t flags;
+  uint8_t reserved;
+};
+
+struct SomfyPoeFleetIpEntry {
+  uint32_t address;  // Host byte order, so entries sort numerically
+  uint32_t record;
+};
+
+static_assert(sizeof(SomfyPoeFleetHeader) == 64, "fleet header layout");
+static_assert(sizeof(SomfyPoeFleetRecord) == 64, "fleet record layout");
+static_assert(sizeof(SomfyPoeFleetIpEntry) == 8, "fleet ip index layout");
+
+}  // namespace somfy_poe
+}  // namespace esphome
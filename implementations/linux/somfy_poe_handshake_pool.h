@@ -0,0 +1,139 @@
+/*
+ * Worker pool for TLS handshakes
+ *
+ * A handshake blocks for the TCP connect, the TLS exchange and two replies
+ * from the motor. When many motors reconnect at once (after a PoE switch
+ * reboot), running them on the loop thread would stall UDP commands for
+ * every other motor. Attached motors hand their handshakes to a bounded set
+ * of worker threads instead; results (target ID and AES key) are applied on
+ * the loop thread by this component's loop().
+ *
+ *   SomfyPoeHandshakePool handshakes(8);
+ *   App.register_component(&handshakes);
+ *   handshakes.attach(&motor);
+ *
+ * Declare the pool after the motors, so it is destroyed (and its workers
+ * joined) first.
+ */
+
+#pragma once
+
+#include "somfy_poe_hub.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeHandshakePool : public Component {
+ public:
+  explicit SomfyPoeHandshakePool(size_t workers = 8, int worker_nice = 10)
+      : worker_count_(workers), worker_nice_(worker_nice) {}
+
+  ~SomfyPoeHandshakePool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+  }
+
+  // Before the motors, which may start handshakes in their setup()
+  float get_setup_priority() const override {
+    return setup_priority::DATA + 1.0f;
+  }
+
+  void setup() override {
+    for (size_t i = 0; i < worker_count_; i++) {
+      workers_.emplace_back([this]() { work(); });
+    }
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE handshake pool: %u workers", (unsigned) worker_count_);
+  }
+
+  // Runs completion callbacks on the loop thread
+  void loop() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_.empty()) return;
+      finished_.swap(completing_);
+    }
+    for (Job& job : completing_) job.done();
+    completing_.clear();
+  }
+
+  void attach(SomfyPoeMotor* motor) {
+    motor->set_handshake_executor([this](SomfyPoeHandshake<SomfyPoeDefaultPlatform>* handshake,
+                                         std::function<void()>&& done) { submit(handshake, std::move(done)); });
+  }
+
+  // Waiting plus running; each motor has at most one handshake here
+  size_t get_pending_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_.size() + running_;
+  }
+
+  uint32_t get_completed_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return completed_;
+  }
+
+ private:
+  struct Job {
+    SomfyPoeHandshake<SomfyPoeDefaultPlatform>* handshake;
+    std::function<void()> done;
+  };
+
+  size_t worker_count_;
+  int worker_nice_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Job> queued_;
+  std::vector<Job> finished_;
+  std::vector<Job> completing_;  // Owned by loop()
+  size_t running_ = 0;
+  uint32_t completed_ = 0;
+  bool stopping_ = false;
+
+  void submit(SomfyPoeHandshake<SomfyPoeDefaultPlatform>* handshake, std::function<void()>&& done) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_.push_back({handshake, std::move(done)});
+    }
+    ready_.notify_one();
+  }
+
+  // Workers run below the loop thread's priority, so on a busy host the
+  // loop keeps its CPU and handshakes take the slack
+  void work() {
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), worker_nice_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      ready_.wait(lock, [this]() { return stopping_ || !queued_.empty(); });
+      if (stopping_) return;
+      Job job = std::move(queued_.front());
+      queued_.pop_front();
+      running_++;
+
+      lock.unlock();
+      job.handshake->run();
+      lock.lock();
+
+      running_--;
+      completed_++;
+      finished_.push_back(std::move(job));
+    }
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
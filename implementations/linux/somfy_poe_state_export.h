@@ -0,0 +1,122 @@
+/*
+ * Publishes the hub's motor states in POSIX shared memory
+ *
+ * Local readers (somfy_poe_state_reader.h) map the segment and read the
+ * whole table without syscalls or requests to the daemon. See
+ * somfy_poe_state_layout.h for the layout.
+ */
+
+#pragma once
+
+#include "somfy_poe_control.h"
+#include "somfy_poe_state_layout.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeStateExport : public Component {
+ public:
+  SomfyPoeStateExport(SomfyPoeHub* hub, const std::string& name, uint32_t capacity = 256)
+      : hub_(hub), name_(name), capacity_(capacity), changed_(hub) {}
+
+  ~SomfyPoeStateExport() {
+    if (header_ == nullptr) return;
+    header_->magic.store(0, std::memory_order_release);
+    munmap(header_, size_);
+    shm_unlink(name_.c_str());
+  }
+
+  // After the hub, so its motors are registered
+  float get_setup_priority() const override {
+    return setup_priority::LATE - 1.0f;
+  }
+
+  void setup() override {
+    size_ = sizeof(SomfyPoeStateHeader) + capacity_ * sizeof(SomfyPoeStateEntry);
+    int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    // Truncating first zeroes a segment left behind by an earlier run
+    if (fd < 0 || ftruncate(fd, 0) != 0 || ftruncate(fd, size_) != 0) {
+      ESP_LOGE("somfy_poe", "Cannot create shared memory %s: %s", name_.c_str(), strerror(errno));
+      if (fd >= 0) close(fd);
+      return;
+    }
+    void* map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      ESP_LOGE("somfy_poe", "Cannot map shared memory %s: %s", name_.c_str(), strerror(errno));
+      return;
+    }
+
+    header_ = static_cast<SomfyPoeStateHeader*>(map);
+    entries_ = reinterpret_cast<SomfyPoeStateEntry*>(header_ + 1);
+    header_->version = SOMFY_POE_STATE_VERSION;
+    header_->header_size = sizeof(SomfyPoeStateHeader);
+    header_->entry_size = sizeof(SomfyPoeStateEntry);
+    header_->capacity = capacity_;
+    header_->magic.store(SOMFY_POE_STATE_MAGIC, std::memory_order_release);
+    changed_.mark_all();
+  }
+
+  void dump_config() override {
+    ESP_LOGCONFIG("somfy_poe", "Somfy PoE state export: %s (%u entries)", name_.c_str(), capacity_);
+  }
+
+  void loop() override {
+    if (header_ == nullptr) return;
+    const std::vector<SomfyPoeMotor*>& motors = hub_->get_motors();
+    uint32_t count = motors.size();
+    if (count > capacity_) {
+      if (!warned_capacity_) ESP_LOGW("somfy_poe", "State export holds only %u of %u motors", capacity_, count);
+      warned_capacity_ = true;
+      count = capacity_;
+    }
+    published_.resize(count);
+
+    // Only motors that reported something since the last pass
+    bool changed = false;
+    changed_.take(count, [this, &motors, &changed](size_t i) {
+      SomfyPoeStateRecord record = {};
+      strncpy(record.ip, motors[i]->get_motor_ip(), sizeof(record.ip) - 1);
+      record.state = somfy_poe_control_state(motors[i]);
+      if (memcmp(record.ip, published_[i].ip, sizeof(record.ip)) == 0 && record.state == published_[i].state) {
+        return;
+      }
+      record.updated_ms = millis();
+      published_[i] = record;
+      write_entry(&entries_[i], record);
+      changed = true;
+    });
+
+    if (header_->count.load(std::memory_order_relaxed) != count) {
+      header_->count.store(count, std::memory_order_release);
+      changed = true;
+    }
+    if (changed) header_->generation.fetch_add(1, std::memory_order_release);
+  }
+
+ private:
+  SomfyPoeHub* hub_;
+  std::string name_;
+  uint32_t capacity_;
+  size_t size_ = 0;
+  SomfyPoeStateHeader* header_ = nullptr;
+  SomfyPoeStateEntry* entries_ = nullptr;
+  SomfyPoeChangedMotors changed_;
+  std::vector<SomfyPoeStateRecord> published_;
+  bool warned_capacity_ = false;
+
+  static void write_entry(SomfyPoeStateEntry* entry, const SomfyPoeStateRecord& record) {
+    uint32_t seq = entry->seq.load(std::memory_order_relaxed);
+    entry->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&entry->record, &record, sizeof(record));
+    entry->seq.store(seq + 2, std::memory_order_release);
+  }
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
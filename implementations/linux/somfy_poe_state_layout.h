@@ -0,0 +1,61 @@
+/*
+ * Shared-memory layout of the daemon's motor state table
+ *
+ * The segment (default "/somfy_poe_state") holds a 64-byte header followed
+ * by `capacity` 32-byte entries, one per motor in hub order:
+ *
+ *   header   magic "SPOS", version, header/entry sizes, capacity,
+ *            count of valid entries, generation
+ *   entry    seq, then updated_ms, ip[16] and SomfyPoeControlState
+ *
+ * Entries are seqlocks: the daemon makes seq odd while it writes an entry
+ * and even again afterwards, so a reader that sees the same even seq before
+ * and after copying has a consistent entry. The generation increases after
+ * every loop pass that changed an entry, so readers can skip unchanged
+ * tables. The daemon clears the magic when it exits.
+ *
+ * All fields are native-endian; readers run on the same host.
+ */
+
+#pragma once
+
+#include "somfy_poe_control_protocol.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace somfy_poe {
+
+static const uint32_t SOMFY_POE_STATE_MAGIC = 0x534f5053;  // "SPOS"
+static const uint16_t SOMFY_POE_STATE_VERSION = 1;
+
+struct alignas(64) SomfyPoeStateHeader {
+  std::atomic<uint32_t> magic;
+  uint16_t version;
+  uint16_t header_size;
+  uint16_t entry_size;
+  uint16_t reserved;
+  uint32_t capacity;
+  std::atomic<uint32_t> count;
+  std::atomic<uint64_t> generation;
+};
+
+struct SomfyPoeStateRecord {
+  uint32_t updated_ms;  // Daemon's millis() at the last change
+  char ip[16];
+  SomfyPoeControlState state;
+};
+
+struct SomfyPoeStateEntry {
+  std::atomic<uint32_t> seq;
+  SomfyPoeStateRecord record;
+};
+
+static_assert(sizeof(SomfyPoeStateHeader) == 64, "state header layout");
+static_assert(sizeof(SomfyPoeStateEntry) == 32, "state entry layout");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free");
+
+}  // namespace somfy_poe
+}  // namespace esphome
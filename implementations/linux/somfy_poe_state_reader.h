@@ -0,0 +1,111 @@
+/*
+ * Reader for the daemon's shared-memory state table
+ *
+ *   SomfyPoeStateReader reader;
+ *   reader.open("/somfy_poe_state");
+ *   std::vector<SomfyPoeStateRecord> motors;
+ *   reader.read_all(&motors);
+ *
+ * Reads are plain memory loads; any number of readers can poll without
+ * affecting the daemon. If is_valid() turns false, the daemon has exited
+ * or restarted: open() the segment again.
+ */
+
+#pragma once
+
+#include "somfy_poe_state_layout.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+namespace esphome {
+namespace somfy_poe {
+
+class SomfyPoeStateReader {
+ public:
+  ~SomfyPoeStateReader() {
+    close();
+  }
+
+  bool open(const char* name = "/somfy_poe_state") {
+    close();
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SomfyPoeStateHeader)) {
+      ::close(fd);
+      return false;
+    }
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    header_ = static_cast<const SomfyPoeStateHeader*>(map);
+    size_ = info.st_size;
+    // Only this exact layout is understood
+    if (!is_valid() || header_->version != SOMFY_POE_STATE_VERSION ||
+        header_->header_size != sizeof(SomfyPoeStateHeader) || header_->entry_size != sizeof(SomfyPoeStateEntry) ||
+        size_ < sizeof(SomfyPoeStateHeader) + header_->capacity * sizeof(SomfyPoeStateEntry)) {
+      close();
+      return false;
+    }
+    entries_ = reinterpret_cast<const SomfyPoeStateEntry*>(header_ + 1);
+    return true;
+  }
+
+  void close() {
+    if (header_ != nullptr) munmap(const_cast<SomfyPoeStateHeader*>(header_), size_);
+    header_ = nullptr;
+    entries_ = nullptr;
+  }
+
+  // False once the daemon that created the segment has exited
+  bool is_valid() const {
+    return header_ != nullptr && header_->magic.load(std::memory_order_acquire) == SOMFY_POE_STATE_MAGIC;
+  }
+
+  uint32_t get_count() const {
+    return header_ != nullptr ? header_->count.load(std::memory_order_acquire) : 0;
+  }
+
+  // Changes whenever an entry changes
+  uint64_t get_generation() const {
+    return header_ != nullptr ? header_->generation.load(std::memory_order_acquire) : 0;
+  }
+
+  // Copies one entry. Fails if the index is out of range, or if the entry
+  // stays mid-write (a daemon that died while writing).
+  bool read(uint32_t index, SomfyPoeStateRecord* out) const {
+    if (index >= get_count()) return false;
+    const SomfyPoeStateEntry& entry = entries_[index];
+    for (int attempt = 0; attempt < 10000; attempt++) {
+      uint32_t before = entry.seq.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      memcpy(out, &entry.record, sizeof(*out));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (entry.seq.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+  }
+
+  bool read_all(std::vector<SomfyPoeStateRecord>* out) const {
+    if (!is_valid()) return false;
+    out->resize(get_count());
+    for (uint32_t i = 0; i < out->size(); i++) {
+      if (!read(i, &(*out)[i])) return false;
+    }
+    return true;
+  }
+
+ private:
+  const SomfyPoeStateHeader* header_ = nullptr;
+  const SomfyPoeStateEntry* entries_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace somfy_poe
+}  // namespace esphome
@@ -0,0 +1,25 @@
+/*
+ * Minimal checks for the tests in this directory
+ *
+ * Each test is a program that returns nonzero if a CHECK failed; CTest runs
+ * them (see CMakeLists.txt).
+ */
+
+#pragma once
+
+#include <cstdio>
+
+static int test_failures = 0;
+
+#define CHECK(condition)                                                 \
+  do {                                                                   \
+    if (!(condition)) {                                                  \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      test_failures++;                                                   \
+    }                                                                    \
+  } while (0)
+
+static int test_result() {
+  if (test_failures > 0) fprintf(stderr, "%d check(s) failed\n", test_failures);
+  return test_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Control socket round trips for a fleet beyond one frame and u16 counts
+ *
+ * 70000 motors (never set up, so nothing goes on the network): LIST and
+ * SNAPSHOT take several pages, a MOVE request is split, and a subscriber's
+ * first CHANGE frames address motors past 65535. A later subscriber gets
+ * its own first CHANGE frames without repeating them to the others, and a
+ * single motor's change reaches both as one frame.
+ */
+
+#include "somfy_poe_control.h"
+#include "somfy_poe_control_client.h"
+#include "test_check.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace esphome::somfy_poe;
+
+static const char* SOCKET_PATH = "/tmp/somfy_poe_test_paging.sock";
+static const uint32_t MOTOR_COUNT = 70000;
+
+int main() {
+  host_log_level = HOST_LOG_WARN;
+
+  std::vector<std::string> ips;
+  for (uint32_t i = 0; i < MOTOR_COUNT; i++) {
+    ips.push_back("10." + std::to_string(i >> 16) + "." + std::to_string((i >> 8) & 0xff) + "." +
+                  std::to_string(i & 0xff));
+  }
+  SomfyPoeHub hub;
+  std::vector<std::unique_ptr<SomfyPoeMotor>> motors;
+  for (const std::string& ip : ips) {
+    motors.emplace_back(new SomfyPoeMotor(ip.c_str(), "1234"));
+    hub.add_motor(motors.back().get());
+  }
+
+  SomfyPoeControlServer server(&hub, SOCKET_PATH);
+  server.setup();
+  std::atomic<bool> done{false};
+  std::thread daemon_thread([&] {
+    while (!done) {
+      server.loop();
+      server.wait(5);
+    }
+  });
+
+  SomfyPoeControlClient client;
+  CHECK(client.connect(SOCKET_PATH));
+
+  std::vector<std::string> listed;
+  CHECK(client.list(&listed));
+  CHECK(listed == ips);
+
+  std::vector<SomfyPoeControlState> states;
+  CHECK(client.snapshot(&states));
+  CHECK(states.size() == MOTOR_COUNT);
+  CHECK(states.back().position < 0.0f);  // Never reported
+
+  // Past the last motor, so every move is refused without touching one
+  std::vector<SomfyPoeControlMove> moves;
+  for (uint32_t i = 0; i < SOMFY_POE_CONTROL_MAX_MOVES + 100; i++) {
+    SomfyPoeControlMove move = {};
+    move.motor = MOTOR_COUNT + i;
+    move.action = SOMFY_POE_ACTION_TO;
+    move.force = 1;
+    move.position = 50.0f;
+    moves.push_back(move);
+  }
+  std::vector<uint8_t> accepted;
+  CHECK(client.move(moves, &accepted));
+  CHECK(accepted.size() == moves.size());
+  CHECK(std::count(accepted.begin(), accepted.end(), 0) == (long) moves.size());
+
+  uint32_t changes = 0;
+  uint32_t last_motor = 0;
+  uint32_t last_changed = 0;
+  CHECK(client.subscribe([&](uint32_t motor, const SomfyPoeControlState&) {
+    changes++;
+    last_motor = std::max(last_motor, motor);
+    last_changed = motor;
+  }));
+  uint32_t deadline = millis() + 10000;
+  while (changes < MOTOR_COUNT && (int32_t) (deadline - millis()) > 0) client.wait_for_changes(100);
+  CHECK(changes == MOTOR_COUNT);
+  CHECK(last_motor == MOTOR_COUNT - 1);
+
+  SomfyPoeControlClient late;
+  CHECK(late.connect(SOCKET_PATH));
+  uint32_t late_changes = 0;
+  uint32_t late_motor = 0;
+  CHECK(late.subscribe([&](uint32_t motor, const SomfyPoeControlState&) {
+    late_changes++;
+    late_motor = motor;
+  }));
+  while (late_changes < MOTOR_COUNT && (int32_t) (deadline - millis()) > 0) late.wait_for_changes(100);
+  CHECK(late_changes == MOTOR_COUNT);
+  client.wait_for_changes(100);
+  CHECK(changes == MOTOR_COUNT);
+
+  done = true;
+  daemon_thread.join();
+
+  // On this thread from here, so the motor and the server do not race
+  static const uint8_t KEY[16] = {};
+  motors[5]->restore_session("4a2b8c6d", KEY);
+  motors[5]->loop();
+  server.loop();
+  client.wait_for_changes(100);
+  late.wait_for_changes(100);
+  CHECK(changes == MOTOR_COUNT + 1);
+  CHECK(last_changed == 5);
+  CHECK(late_changes == MOTOR_COUNT + 1);
+  CHECK(late_motor == 5);
+  return test_result();
+}
@@ -0,0 +1,76 @@
+/*
+ * Awaited moves resume even when the pending table forgets them
+ *
+ * More moves than the motor's pending table holds, each awaited by its own
+ * coroutine, to a motor that never answers (nothing listens on 127.0.0.6).
+ * Every move must get exactly one failed result, and every await must
+ * resume and give its frame back.
+ */
+
+#include "somfy_poe_coro.h"
+#include "test_check.h"
+
+using namespace esphome::somfy_poe;
+
+static const char* MOTOR_IP = "127.0.0.6";
+static const uint8_t KEY[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static const size_t MOVES = 8;  // Twice the pending table
+
+struct Outcome {
+  bool done = false;
+  bool ok = false;
+};
+
+static SomfyPoeTask<bool> awaited_move(SomfyPoeMotor& motor, float position, Outcome* outcome) {
+  outcome->ok = co_await async_move_to(motor, position, true);
+  outcome->done = true;
+  co_return outcome->ok;
+}
+
+int main() {
+  host_log_level = HOST_LOG_ERROR;
+
+  SomfyPoeMotor motor(MOTOR_IP, "1234");
+  motor.set_rate_limit(1e9f, 1e9f);
+  motor.restore_session("4a2b8c6d", KEY);
+  std::vector<uint32_t> failures(MOVES + 1);
+  std::vector<uint32_t> successes(MOVES + 1);
+  motor.add_on_move_result_callback([&](uint32_t seq, bool ok) {
+    if (seq <= MOVES) (ok ? successes : failures)[seq]++;
+  });
+  App.register_component(&motor);
+  App.setup();
+
+  std::vector<Outcome> outcomes(MOVES);
+  std::vector<SomfyPoeTask<bool>> tasks;
+  for (size_t i = 0; i < MOVES; i++) {
+    tasks.push_back(awaited_move(motor, 10.0f + i, &outcomes[i]));
+    tasks.back().start();
+  }
+  CHECK(SomfyPoeFramePool::instance().get_in_use() == MOVES);
+
+  auto all_done = [&tasks] {
+    for (const SomfyPoeTask<bool>& task : tasks) {
+      if (!task.done()) return false;
+    }
+    return true;
+  };
+  SomfyPoeEventLoop& loop = SomfyPoeEventLoop::instance();
+  uint32_t deadline = millis() + 10000;
+  while (!all_done() && (int32_t) (deadline - millis()) > 0) {
+    loop.poll();
+    delay(1);
+  }
+
+  for (uint32_t seq = 1; seq <= MOVES; seq++) {
+    CHECK(failures[seq] == 1);
+    CHECK(successes[seq] == 0);
+  }
+  for (const Outcome& outcome : outcomes) {
+    CHECK(outcome.done);
+    CHECK(!outcome.ok);
+  }
+  tasks.clear();
+  CHECK(SomfyPoeFramePool::instance().get_in_use() == 0);
+  return test_result();
+}
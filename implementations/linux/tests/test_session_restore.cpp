@@ -0,0 +1,99 @@
+/*
+ * Resuming cached sessions
+ *
+ * A simulated motor on 127.0.0.3 hands out the key 0..15. A motor resumed
+ * with that key must not handshake; one resumed with a stale key must fall
+ * back to a handshake, whether its first request times out or a newer
+ * move supersedes it, and end up healthy.
+ */
+
+#include "bench/simulated_motor.h"
+#include "test_check.h"
+
+using namespace esphome::somfy_poe;
+
+static const char* MOTOR_IP = "127.0.0.3";
+static const char* TARGET_ID = "4a2b8c6d";
+static const uint8_t GOOD_KEY[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static const uint8_t STALE_KEY[16] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA,
+                                      0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+
+// Runs the motor's loop until `done` or `timeout_ms`; false on timeout
+template <typename Done> static bool run_until(SomfyPoeMotor* motor, uint32_t timeout_ms, Done done) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start > timeout_ms) return false;
+    motor->loop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// Moves the motor and waits for the motor's reply
+static bool move_answered(SomfyPoeMotor* motor) {
+  bool answered = false;
+  bool ok = false;
+  uint32_t seq = motor->get_move_seq() + 1;
+  motor->add_on_move_result_callback([&, seq](uint32_t result_seq, bool result) {
+    if (result_seq != seq) return;
+    answered = true;
+    ok = result;
+  });
+  motor->move_to_position(30.0f, true);
+  return run_until(motor, 5000, [&] { return answered; }) && ok;
+}
+
+static bool key_is_good(SomfyPoeMotor* motor) {
+  const uint8_t* key = motor->get_session_key();
+  return key != nullptr && memcmp(key, GOOD_KEY, sizeof(GOOD_KEY)) == 0;
+}
+
+int main() {
+  host_log_level = HOST_LOG_ERROR;
+
+  SimulatedMotor simulated(MOTOR_IP, 16);
+  if (!simulated.listen()) {
+    fprintf(stderr, "cannot bind %s:55055/55056\n", MOTOR_IP);
+    return 1;
+  }
+  std::thread motor_thread([&] { simulated.run(); });
+
+  // Accepted key: no handshake
+  {
+    SomfyPoeMotor motor(MOTOR_IP, "1234");
+    motor.set_rate_limit(1e9f, 1e9f);
+    motor.restore_session(TARGET_ID, GOOD_KEY);
+    motor.setup();
+    CHECK(move_answered(&motor));
+    CHECK(simulated.handshakes == 0);
+    CHECK(motor.get_timeout_count() == 0);
+  }
+
+  // Stale key: the restored requests time out, then a handshake
+  {
+    SomfyPoeMotor motor(MOTOR_IP, "1234");
+    motor.set_rate_limit(1e9f, 1e9f);
+    motor.restore_session(TARGET_ID, STALE_KEY);
+    motor.setup();
+    CHECK(run_until(&motor, 20000, [&] { return simulated.handshakes == 1 && key_is_good(&motor); }));
+    CHECK(move_answered(&motor));
+    CHECK(motor.get_health() == SomfyPoeHealth::HEALTHY);
+  }
+
+  // Stale key: a superseded move expires long before the retransmits run out
+  {
+    SomfyPoeMotor motor(MOTOR_IP, "1234");
+    motor.set_rate_limit(1e9f, 1e9f);
+    motor.restore_session(TARGET_ID, STALE_KEY);
+    motor.setup();
+    motor.move_to_position(10.0f, true);
+    motor.move_to_position(20.0f, true);
+    CHECK(run_until(&motor, 3000, [&] { return simulated.handshakes == 2 && key_is_good(&motor); }));
+    CHECK(move_answered(&motor));
+    CHECK(motor.get_health() == SomfyPoeHealth::HEALTHY);
+  }
+
+  simulated.running = false;
+  motor_thread.join();
+  return test_result();
+}
@@ -0,0 +1,103 @@
+/*
+ * Replies reach the motor that sent the request
+ *
+ * Three simulated motors on 127.0.0.3-5, each with its own session key, so
+ * a reply handed to the wrong motor fails to decrypt. The hub's motors
+ * share its UDP socket; every move must be answered without a retransmit,
+ * even after an empty datagram arrives mid-run.
+ */
+
+#include "somfy_poe_hub.h"
+#include "bench/simulated_motor.h"
+#include "test_check.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace esphome::somfy_poe;
+
+static const char* MOTOR_IPS[] = {"127.0.0.3", "127.0.0.4", "127.0.0.5"};
+static const size_t MOTOR_COUNT = sizeof(MOTOR_IPS) / sizeof(MOTOR_IPS[0]);
+static const uint32_t MOVES = 50;
+
+// A zero-length datagram to the controller's port, from an address without a motor
+static bool send_empty_datagram() {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return false;
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(55055);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bool sent = sendto(fd, "", 0, 0, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+  close(fd);
+  return sent;
+}
+
+struct Results {
+  uint32_t ok = 0;
+  uint32_t failed = 0;
+};
+
+int main() {
+  host_log_level = HOST_LOG_WARN;
+
+  std::vector<std::unique_ptr<SimulatedMotor>> simulated;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < MOTOR_COUNT; i++) {
+    simulated.emplace_back(new SimulatedMotor(MOTOR_IPS[i], MOVES, nullptr, 0, i * 32));
+    if (!simulated.back()->listen()) {
+      fprintf(stderr, "cannot bind %s:55055/55056\n", MOTOR_IPS[i]);
+      return 1;
+    }
+  }
+  for (auto& motor : simulated) threads.emplace_back([&motor] { motor->run(); });
+
+  SomfyPoeHub hub;
+  std::vector<std::unique_ptr<SomfyPoeMotor>> motors;
+  std::vector<Results> results(MOTOR_COUNT);
+  for (size_t i = 0; i < MOTOR_COUNT; i++) {
+    motors.emplace_back(new SomfyPoeMotor(MOTOR_IPS[i], "1234"));
+    motors.back()->set_rate_limit(1e9f, 1e9f);
+    Results* result = &results[i];
+    motors.back()->add_on_move_result_callback([result](uint32_t, bool ok) { (ok ? result->ok : result->failed)++; });
+    App.register_component(motors.back().get());
+    hub.add_motor(motors.back().get());
+  }
+  App.register_component(&hub);
+  App.setup();
+  CHECK(hub.get_udp_socket().get_route_count() == MOTOR_COUNT);
+  for (auto& motor : motors) CHECK(motor->is_authenticated());
+
+  // A move to every motor at once, so their replies interleave. One round
+  // at a time, as the pending table only remembers a few requests.
+  auto answered = [&results](uint32_t moves) {
+    for (const Results& result : results) {
+      if (result.ok + result.failed < moves) return false;
+    }
+    return true;
+  };
+  uint32_t deadline = millis() + 10000;
+  for (uint32_t move = 1; move <= MOVES; move++) {
+    if (move == MOVES / 2) CHECK(send_empty_datagram());
+    for (auto& motor : motors) motor->move_to_position(move % 2 ? 20.0f : 10.0f, true);
+    while (!answered(move) && (int32_t) (deadline - millis()) > 0) App.loop();
+  }
+
+  for (size_t i = 0; i < MOTOR_COUNT; i++) {
+    CHECK(results[i].ok == MOVES);
+    CHECK(results[i].failed == 0);
+    CHECK(motors[i]->get_retransmit_count() == 0);
+    CHECK(motors[i]->get_timeout_count() == 0);
+    CHECK(motors[i]->get_health() == SomfyPoeHealth::HEALTHY);
+  }
+  CHECK(hub.get_udp_socket().get_unrouted_count() == 0);
+
+  for (auto& motor : motors) hub.remove_motor(motor.get());
+  CHECK(hub.get_udp_socket().get_route_count() == 0);
+
+  for (auto& motor : simulated) motor->running = false;
+  for (std::thread& thread : threads) thread.join();
+  return test_result();
+}